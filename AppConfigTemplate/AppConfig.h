@@ -89,6 +89,15 @@
 #define VF_USE_LEAKCHECKED 1
 #endif
 
+/** Collect latency and depth statistics in every CallQueue.
+
+    This adds a timestamp to each queued functor and a few atomic
+    operations to each call. See CallQueue::getStatistics().
+*/
+#ifndef VF_USE_CALLQUEUE_STATISTICS
+#define VF_USE_CALLQUEUE_STATISTICS 0
+#endif
+
 /*============================================================================*/
 
 // Ignore this
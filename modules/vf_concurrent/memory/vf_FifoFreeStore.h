@@ -33,7 +33,7 @@
 #ifndef VF_FIFOFREESTORE_VFHEADER
 #define VF_FIFOFREESTORE_VFHEADER
 
-#if VF_USE_BOOST
+#if VF_USE_BOOST || VF_USE_NATIVE_TLS
 #include "vf_FifoFreeStoreWithTLS.h"
 
 #else
@@ -41,11 +41,20 @@
 
 #endif
 
+#include "vf_MagazineFreeStore.h"
+
 /** Selected free store based on compilation settings.
 
+    With native thread local storage, small blocks are cached in
+    magazines in front of the store.
+
+    @see MagazineFreeStore
+
     @ingroup vf_concurrent
 */
-#if VF_USE_BOOST
+#if VF_USE_NATIVE_TLS
+typedef MagazineFreeStore <FifoFreeStoreWithTLS> FifoFreeStoreType;
+#elif VF_USE_BOOST
 typedef FifoFreeStoreWithTLS FifoFreeStoreType;
 #else
 typedef FifoFreeStoreWithoutTLS FifoFreeStoreType;
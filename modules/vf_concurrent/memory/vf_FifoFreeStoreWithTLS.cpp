@@ -44,6 +44,12 @@
 //   but uses a global PageAllocator. This reduces memory consumption without
 //   affecting performance.
 //
+// - With native thread local storage, each thread has a table of per-thread
+//   data indexed by allocator id. Ids are reused, so each entry remembers the
+//   serial number of the allocator that created it, and stale entries are
+//   replaced. A thread's table is destroyed when the thread exits, which
+//   returns its active pages right away.
+//
 
 // This precedes every allocation
 //
@@ -71,7 +77,7 @@ public:
 
   inline bool release ()
   {
-    jassert (! m_refs.isSignaled ());
+    jassert (m_refs.isSignaled ());
 
     return m_refs.release ();
   }
@@ -111,14 +117,25 @@ public:
   explicit PerThreadData (FifoFreeStoreWithTLS* allocator)
     : m_allocator (*allocator)
     , m_active (m_allocator.newPage ())
+#if VF_USE_NATIVE_TLS
+    , m_serial (m_allocator.m_serial)
+#endif
   {
   }
 
+  // The allocator might be gone by now, so don't touch it.
   ~PerThreadData ()
   {
     if (m_active->release ())
-      m_allocator.deletePage (m_active);
+      deletePage (m_active);
+  }
+
+#if VF_USE_NATIVE_TLS
+  inline int getSerial () const
+  {
+    return m_serial;
   }
+#endif
 
   inline void* allocate (const size_t bytes)
   {
@@ -150,8 +167,172 @@ public:
 private:
   FifoFreeStoreWithTLS& m_allocator;
   Page* m_active;
+#if VF_USE_NATIVE_TLS
+  int const m_serial;
+#endif
+};
+
+//------------------------------------------------------------------------------
+
+#if VF_USE_NATIVE_TLS
+
+// Hands out allocator ids and serial numbers, and owns the
+// key whose destructor cleans up after an exiting thread.
+//
+class FifoFreeStoreWithTLS::Registry
+  : public RefCountedSingleton <Registry>
+  , LeakChecked <Registry>
+{
+public:
+  int acquireId ()
+  {
+    LockType::ScopedLockType lock (m_mutex);
+
+    int id;
+
+    if (! m_freeIds.empty ())
+    {
+      id = m_freeIds.back ();
+      m_freeIds.pop_back ();
+    }
+    else
+      id = m_numberOfIds++;
+
+    return id;
+  }
+
+  void releaseId (int id)
+  {
+    LockType::ScopedLockType lock (m_mutex);
+
+    m_freeIds.push_back (id);
+  }
+
+  int getNextSerial ()
+  {
+    return ++m_serial;
+  }
+
+  pthread_key_t getKey () const
+  {
+    return m_key;
+  }
+
+  static Registry* createInstance ()
+  {
+    return new Registry;
+  }
+
+private:
+  typedef SpinLock LockType;
+
+  Registry ()
+    : RefCountedSingleton <Registry> (SingletonLifetime::persistAfterCreation)
+    , m_numberOfIds (0)
+  {
+    int const result = pthread_key_create (&m_key, &FifoFreeStoreWithTLS::destroyTable);
+
+    if (result != 0)
+      Throw (Error().fail (__FILE__, __LINE__, TRANS("pthread_key_create failed")));
+  }
+
+  // The key is never deleted, since threads
+  // can still exit after we are gone.
+  ~Registry ()
+  {
+  }
+
+private:
+  LockType m_mutex;
+  std::vector <int> m_freeIds;
+  int m_numberOfIds;
+  Atomic <int> m_serial;
+  pthread_key_t m_key;
+};
+
+//------------------------------------------------------------------------------
+
+// A thread's per-thread data, indexed by allocator id.
+//
+struct FifoFreeStoreWithTLS::Table
+{
+  int size;
+  PerThreadData** data;
 };
 
+__thread FifoFreeStoreWithTLS::Table* FifoFreeStoreWithTLS::s_table;
+
+inline FifoFreeStoreWithTLS::PerThreadData* FifoFreeStoreWithTLS::getPerThreadData ()
+{
+  Table* const table = s_table;
+
+  if (table != nullptr && m_id < table->size)
+  {
+    PerThreadData* const data = table->data [m_id];
+
+    if (data != nullptr && data->getSerial () == m_serial)
+      return data;
+  }
+
+  return createPerThreadData ();
+}
+
+FifoFreeStoreWithTLS::PerThreadData* FifoFreeStoreWithTLS::createPerThreadData ()
+{
+  Table* table = s_table;
+
+  if (table == nullptr)
+  {
+    table = new Table;
+    table->size = 0;
+    table->data = nullptr;
+
+    s_table = table;
+
+    // Arms the thread exit hook.
+    pthread_setspecific (m_registry->getKey (), table);
+  }
+
+  if (m_id >= table->size)
+  {
+    int const newSize = jmax (jmax (m_id + 1, 2 * table->size), 8);
+    PerThreadData** const data = new PerThreadData* [newSize];
+
+    for (int i = 0; i < newSize; ++i)
+      data [i] = (i < table->size) ? table->data [i] : nullptr;
+
+    delete [] table->data;
+
+    table->data = data;
+    table->size = newSize;
+  }
+
+  // Replace data left over from a previous allocator with the same id.
+  delete table->data [m_id];
+
+  table->data [m_id] = new PerThreadData (this);
+
+  return table->data [m_id];
+}
+
+// Called when a thread exits.
+//
+void FifoFreeStoreWithTLS::destroyTable (void* p)
+{
+  Table* const table = static_cast <Table*> (p);
+
+  // Allocations from other destructors will start a new table.
+  s_table = nullptr;
+
+  for (int i = 0; i < table->size; ++i)
+    delete table->data [i];
+
+  delete [] table->data;
+  delete table;
+}
+
+#endif
+
 //------------------------------------------------------------------------------
 
 inline FifoFreeStoreWithTLS::Page* FifoFreeStoreWithTLS::newPage ()
@@ -168,6 +349,11 @@ inline void FifoFreeStoreWithTLS::deletePage (Page* page)
 
 FifoFreeStoreWithTLS::FifoFreeStoreWithTLS ()
   : m_pages (PagedFreeStoreType::getInstance ())
+#if VF_USE_NATIVE_TLS
+  , m_registry (Registry::getInstance ())
+  , m_id (m_registry->acquireId ())
+  , m_serial (m_registry->getNextSerial ())
+#endif
 {
   //jassert (m_pages->getPageBytes () >= sizeof (Page) + Memory::allocAlignBytes);
 }
@@ -176,13 +362,34 @@ FifoFreeStoreWithTLS::~FifoFreeStoreWithTLS ()
 {
   // Clean up this thread's data before we release
   // the reference to the global page allocator.
+#if VF_USE_NATIVE_TLS
+  Table* const table = s_table;
+
+  if (table != nullptr && m_id < table->size)
+  {
+    PerThreadData* const data = table->data [m_id];
+
+    if (data != nullptr && data->getSerial () == m_serial)
+    {
+      delete data;
+      table->data [m_id] = nullptr;
+    }
+  }
+
+  // Other threads clean up on exit, or when the id is reused.
+  m_registry->releaseId (m_id);
+#else
   m_tsp.reset (0);
+#endif
 }
 
 //------------------------------------------------------------------------------
 
 void* FifoFreeStoreWithTLS::allocate (const size_t bytes)
 {
+#if VF_USE_NATIVE_TLS
+  PerThreadData* const data = getPerThreadData ();
+#else
   PerThreadData* data = m_tsp.get ();
 
   if (!data)
@@ -190,6 +397,7 @@ void* FifoFreeStoreWithTLS::allocate (const size_t bytes)
     data = new PerThreadData (this);
     m_tsp.reset (data);
   }
+#endif
 
   return data->allocate (bytes);
 }
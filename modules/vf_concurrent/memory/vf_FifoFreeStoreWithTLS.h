@@ -44,7 +44,10 @@
   as allocations.
 
   @note This implementation uses Thread Local Storage to further improve
-        performance. However, it requires boost style thread_specific_ptr.
+        performance. When VF_USE_NATIVE_TLS is set, the compiler's thread
+        local storage is used, and a thread's data is released as soon as
+        the thread exits. Otherwise, it requires boost style
+        thread_specific_ptr.
 
   @invariant allocate() and deallocate() are fully concurrent.
 
@@ -72,9 +75,27 @@ private:
 
 private:
   class PerThreadData;
+
+#if VF_USE_NATIVE_TLS
+  class Registry;
+  struct Table;
+
+  inline PerThreadData* getPerThreadData ();
+  PerThreadData* createPerThreadData ();
+  static void destroyTable (void* p);
+
+  static __thread Table* s_table;
+#else
   boost::thread_specific_ptr <PerThreadData> m_tsp;
+#endif
 
   PagedFreeStoreType::Ptr m_pages;
+
+#if VF_USE_NATIVE_TLS
+  ReferenceCountedObjectPtr <Registry> m_registry;
+  int const m_id;
+  int const m_serial;
+#endif
 };
 
 #endif
@@ -0,0 +1,469 @@
+/*============================================================================*/
+/*
+  VFLib: https://github.com/vinniefalco/VFLib
+
+  Copyright (C) 2008 by Vinnie Falco <vinnie.falco@gmail.com>
+
+  This library contains portions of other open source products covered by
+  separate licenses. Please see the corresponding source files for specific
+  terms.
+  
+  VFLib is provided under the terms of The MIT License (MIT):
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+  IN THE SOFTWARE.
+*/
+/*============================================================================*/
+
+#ifndef VF_MAGAZINEFREESTORE_VFHEADER
+#define VF_MAGAZINEFREESTORE_VFHEADER
+
+#if VF_USE_NATIVE_TLS
+
+#include "vf_GlobalPagedFreeStore.h"
+
+/*============================================================================*/
+/**
+  A cache of recently freed blocks in front of a FIFO free store.
+
+  Each allocation from a FIFO free store touches shared state: the active
+  block or page, and the reference count of the block it came from. When many
+  threads allocate from the same store, for example producers posting to one
+  CallQueue, those cache lines bounce between cores.
+
+  This layer keeps freed blocks of a few small sizes in magazines, which are
+  bounded stacks of blocks. Every thread owns a pair of magazines for each
+  size, kept in the compiler's thread local storage, so the cache is used
+  without locks. Full and empty magazines are exchanged with a global depot
+  through lock-free stacks, so a thread touches shared state only once per
+  magazine. Allocations too large for a magazine, and any that miss the
+  cache, go to the underlying store.
+
+  When a thread exits, its magazines go back to the depot. All magazines are
+  created with the depot, so freeing a block never allocates. When no empty
+  magazine of the right size is left, freed blocks go straight back to the
+  underlying store.
+
+  A cached block keeps the whole page it came from alive, 8 KB with the
+  global paged free store. The number of magazines is chosen so that in
+  the worst case, where every cached block is on a different page, at most
+  4 MB of pages are held: 8 magazines of 16 blocks for each size. Each size
+  has its own magazines, so threads freeing one size cannot take the cache
+  away from another. Blocks freed in FIFO order usually share pages, so the
+  typical figure is much lower.
+
+  This is only available with VF_USE_NATIVE_TLS.
+
+  @param FreeStore  The underlying store, with the interface of
+                    FifoFreeStoreWithoutTLS.
+
+  @invariant allocate() and deallocate() are fully concurrent.
+
+  @ingroup vf_concurrent
+*/
+template <class FreeStore>
+class MagazineFreeStore : Uncopyable
+{
+public:
+  MagazineFreeStore ()
+    : m_depot (Depot::getInstance ())
+  {
+  }
+
+  ~MagazineFreeStore ()
+  {
+  }
+
+  void* allocate (const size_t bytes)
+  {
+    size_t const headerBytes = Memory::sizeAdjustedForAlignment (sizeof (Header));
+    size_t const bytesNeeded = headerBytes + bytes;
+
+    int sizeClass = 0;
+    while (sizeClass < numberOfSizeClasses && bytesNeeded > getSizeClassBytes (sizeClass))
+      ++sizeClass;
+
+    Header* header;
+
+    if (sizeClass < numberOfSizeClasses)
+    {
+      header = static_cast <Header*> (Depot::allocate (getCache (m_depot), sizeClass));
+
+      if (header == nullptr)
+        header = static_cast <Header*> (m_store.allocate (getSizeClassBytes (sizeClass)));
+    }
+    else
+    {
+      header = static_cast <Header*> (m_store.allocate (bytesNeeded));
+    }
+
+    header->depot = m_depot;
+    header->sizeClass = sizeClass;
+
+    return reinterpret_cast <char*> (header) + headerBytes;
+  }
+
+  static void deallocate (void* const p)
+  {
+    size_t const headerBytes = Memory::sizeAdjustedForAlignment (sizeof (Header));
+    Header* const header = reinterpret_cast <Header*> (reinterpret_cast <char*> (p) - headerBytes);
+
+    if (header->sizeClass >= numberOfSizeClasses ||
+        ! Depot::deallocate (getCache (header->depot), header->sizeClass, header))
+    {
+      FreeStore::deallocate (header);
+    }
+  }
+
+private:
+  enum
+  {
+    /** Number of distinct block sizes kept in magazines. */
+    numberOfSizeClasses = 4,
+
+    /** Block size of the smallest class, each class doubles it. */
+    smallestBlockBytes = 64,
+
+    /** Number of blocks a magazine holds. */
+    magazineCapacity = 16,
+
+    /** Worst case bytes of underlying pages kept alive by cached blocks. */
+    maximumPinnedBytes = 4 * 1024 * 1024
+  };
+
+  static size_t getSizeClassBytes (int sizeClass)
+  {
+    return size_t (smallestBlockBytes) << sizeClass;
+  }
+
+  class Depot;
+  class Magazine;
+
+  // This precedes every allocation
+  struct Header
+  {
+    Depot* depot;
+    int sizeClass;
+  };
+
+  // A thread's magazines. This lives in thread local storage, so it has
+  // to be plain data, and it holds a counted reference to the depot by
+  // hand. Nothing but its own thread ever touches it.
+  //
+  struct Cache
+  {
+    Depot* depot;
+    Magazine* loaded [numberOfSizeClasses];
+    Magazine* previous [numberOfSizeClasses];
+  };
+
+  static __thread Cache s_cache;
+
+  static Cache& getCache (Depot* depot)
+  {
+    Cache& cache = s_cache;
+
+    if (cache.depot == nullptr)
+      Depot::attach (cache, depot);
+
+    return cache;
+  }
+
+  //----------------------------------------------------------------------------
+
+  class Magazine : public TaggedLockFreeStack <Magazine>::Node
+  {
+  public:
+    Magazine () : m_count (0)
+    {
+    }
+
+    bool isEmpty () const
+    {
+      return m_count == 0;
+    }
+
+    bool isFull () const
+    {
+      return m_count == magazineCapacity;
+    }
+
+    void push (void* block)
+    {
+      jassert (! isFull ());
+
+      m_rounds [m_count++] = block;
+    }
+
+    void* pop ()
+    {
+      jassert (! isEmpty ());
+
+      return m_rounds [--m_count];
+    }
+
+  private:
+    int m_count;
+    void* m_rounds [magazineCapacity];
+  };
+
+  //----------------------------------------------------------------------------
+
+  class Depot : public RefCountedSingleton <Depot>
+  {
+  public:
+    // Returns nullptr if there are no cached blocks of this size.
+    //
+    static void* allocate (Cache& cache, int sizeClass)
+    {
+      Depot& depot = *cache.depot;
+      Magazine*& loaded = cache.loaded [sizeClass];
+      Magazine*& previous = cache.previous [sizeClass];
+
+      if (loaded == nullptr || loaded->isEmpty ())
+      {
+        if (previous != nullptr && ! previous->isEmpty ())
+        {
+          std::swap (loaded, previous);
+        }
+        else
+        {
+          Magazine* const full = depot.m_full [sizeClass].pop_front ();
+
+          if (full == nullptr)
+          {
+            // Hand our empty magazines back, so that
+            // threads which free blocks can use them.
+            //
+            if (loaded != nullptr)
+              depot.m_empty [sizeClass].push_front (loaded);
+
+            if (previous != nullptr)
+              depot.m_empty [sizeClass].push_front (previous);
+
+            loaded = nullptr;
+            previous = nullptr;
+
+            return nullptr;
+          }
+
+          if (previous != nullptr)
+            depot.m_empty [sizeClass].push_front (previous);
+
+          previous = loaded;
+          loaded = full;
+        }
+      }
+
+      return loaded->pop ();
+    }
+
+    // Returns false if the block was not cached.
+    //
+    static bool deallocate (Cache& cache, int sizeClass, void* block)
+    {
+      Depot& depot = *cache.depot;
+      Magazine*& loaded = cache.loaded [sizeClass];
+      Magazine*& previous = cache.previous [sizeClass];
+
+      if (loaded == nullptr)
+      {
+        loaded = depot.m_empty [sizeClass].pop_front ();
+
+        if (loaded == nullptr)
+          return false;
+      }
+
+      if (loaded->isFull ())
+      {
+        if (previous != nullptr && ! previous->isFull ())
+        {
+          std::swap (loaded, previous);
+        }
+        else
+        {
+          Magazine* const empty = depot.m_empty [sizeClass].pop_front ();
+
+          if (empty == nullptr)
+            return false;
+
+          if (previous != nullptr)
+            depot.m_full [sizeClass].push_front (previous);
+
+          previous = loaded;
+          loaded = empty;
+        }
+      }
+
+      loaded->push (block);
+
+      return true;
+    }
+
+    // Called on a thread's first use of the cache.
+    //
+    static void attach (Cache& cache, Depot* depot)
+    {
+      depot->incReferenceCount ();
+
+      cache.depot = depot;
+
+      // Arms the thread exit hook.
+      pthread_setspecific (depot->m_key, &cache);
+    }
+
+    // Called when a thread exits, and for the thread which runs the exit
+    // handlers. Magazines which still hold blocks go back as full ones.
+    //
+    static void detach (void* p)
+    {
+      Cache& cache = *static_cast <Cache*> (p);
+      Depot* const depot = cache.depot;
+
+      for (int sizeClass = 0; sizeClass < numberOfSizeClasses; ++sizeClass)
+      {
+        depot->putBack (sizeClass, cache.loaded [sizeClass]);
+        depot->putBack (sizeClass, cache.previous [sizeClass]);
+
+        cache.loaded [sizeClass] = nullptr;
+        cache.previous [sizeClass] = nullptr;
+      }
+
+      pthread_setspecific (depot->m_key, nullptr);
+
+      // Frees from other destructors will attach again.
+      cache.depot = nullptr;
+
+      depot->decReferenceCount ();
+    }
+
+    static Depot* createInstance ()
+    {
+      return new Depot;
+    }
+
+  private:
+    // Returns the calling thread's magazines at program exit, since
+    // the main thread does not run the thread exit hook. This comes
+    // after the singleton in the list, so it runs first.
+    //
+    class ExitHook : public PerformedAtExit
+    {
+    public:
+      explicit ExitHook (Depot* depot) : m_depot (depot)
+      {
+      }
+
+    private:
+      void performAtExit ()
+      {
+        if (s_cache.depot == m_depot)
+          detach (&s_cache);
+      }
+
+      Depot* const m_depot;
+    };
+
+    Depot ()
+      : RefCountedSingleton <Depot> (SingletonLifetime::persistAfterCreation)
+      , m_pages (GlobalPagedFreeStore::getInstance ())
+      , m_exitHook (this)
+    {
+      int const result = pthread_key_create (&m_key, &Depot::detach);
+
+      if (result != 0)
+        Throw (Error().fail (__FILE__, __LINE__, TRANS("pthread_key_create failed")));
+
+      // Every magazine is created up front, so that deallocate() never
+      // goes to the system heap. A cached block keeps its whole page
+      // alive, so the number of magazines is what bounds the memory.
+      //
+      size_t const pinnedBytesPerMagazine = magazineCapacity * m_pages->getPageBytes ();
+
+      int const magazinesPerSizeClass = jmax (2,
+        int (maximumPinnedBytes / (pinnedBytesPerMagazine * numberOfSizeClasses)));
+
+      for (int sizeClass = 0; sizeClass < numberOfSizeClasses; ++sizeClass)
+        for (int i = 0; i < magazinesPerSizeClass; ++i)
+          m_empty [sizeClass].push_front (new Magazine);
+    }
+
+    // Every cache holds a reference, so by now
+    // all the magazines are back in the stacks.
+    //
+    ~Depot ()
+    {
+      for (int sizeClass = 0; sizeClass < numberOfSizeClasses; ++sizeClass)
+      {
+        deleteMagazines (m_full [sizeClass]);
+        deleteMagazines (m_empty [sizeClass]);
+      }
+
+      pthread_key_delete (m_key);
+    }
+
+    void putBack (int sizeClass, Magazine* magazine)
+    {
+      if (magazine != nullptr)
+      {
+        if (magazine->isEmpty ())
+          m_empty [sizeClass].push_front (magazine);
+        else
+          m_full [sizeClass].push_front (magazine);
+      }
+    }
+
+    static void deleteMagazines (TaggedLockFreeStack <Magazine>& stack)
+    {
+      for (;;)
+      {
+        Magazine* const magazine = stack.pop_front ();
+
+        if (magazine == nullptr)
+          break;
+
+        while (! magazine->isEmpty ())
+          FreeStore::deallocate (magazine->pop ());
+
+        delete magazine;
+      }
+    }
+
+  private:
+    // Keeps the pages alive until the cached blocks are returned.
+    GlobalPagedFreeStore::Ptr m_pages;
+    ExitHook m_exitHook;
+    pthread_key_t m_key;
+    // Magazines are only deleted with the depot, so
+    // the stacks never see a node that was freed.
+    // A partly used magazine counts as full.
+    TaggedLockFreeStack <Magazine> m_full [numberOfSizeClasses];
+    TaggedLockFreeStack <Magazine> m_empty [numberOfSizeClasses];
+  };
+
+private:
+  FreeStore m_store;
+  typename Depot::Ptr m_depot;
+};
+
+template <class FreeStore>
+__thread typename MagazineFreeStore <FreeStore>::Cache MagazineFreeStore <FreeStore>::s_cache;
+
+#endif
+
+#endif
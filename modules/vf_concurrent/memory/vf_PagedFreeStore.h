@@ -39,6 +39,9 @@
 
   The ABA problem (http://en.wikipedia.org/wiki/ABA_problem) is avoided by
   treating freed pages as garbage, and performing a collection every second.
+  The page stacks are also TaggedLockFreeStack instances, so a thread which
+  is still in the middle of a pop when the pools are swapped cannot corrupt
+  them.
 
   @ingroup vf_concurrent
 */
@@ -73,7 +76,7 @@ private:
 
 private:
   struct Page;
-  typedef LockFreeStack <Page> Pages;
+  typedef TaggedLockFreeStack <Page> Pages;
 
   struct Pool
   {
@@ -0,0 +1,120 @@
+/*============================================================================*/
+/*
+  VFLib: https://github.com/vinniefalco/VFLib
+
+  Copyright (C) 2008 by Vinnie Falco <vinnie.falco@gmail.com>
+
+  This library contains portions of other open source products covered by
+  separate licenses. Please see the corresponding source files for specific
+  terms.
+  
+  VFLib is provided under the terms of The MIT License (MIT):
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+  IN THE SOFTWARE.
+*/
+/*============================================================================*/
+
+BoundedCallQueue::BoundedCallQueue (String name, int capacity)
+  : m_name (name)
+  , m_calls (capacity)
+{
+}
+
+BoundedCallQueue::~BoundedCallQueue ()
+{
+  // Someone forget to close the queue.
+  jassert (m_closed.isSignaled ());
+
+  // Can't destroy queue with unprocessed calls.
+  jassert (m_numberOfPendingCalls.get () == 0);
+}
+
+bool BoundedCallQueue::isAssociatedWithCurrentThread () const
+{
+  return Thread::getCurrentThreadId () == m_id;
+}
+
+bool BoundedCallQueue::synchronize ()
+{
+  bool did_something;
+
+  if (m_isBeingSynchronized.trySignal ())
+  {
+    m_id = Thread::getCurrentThreadId ();
+
+    did_something = doSynchronize ();
+
+    m_isBeingSynchronized.reset ();
+  }
+  else
+  {
+    did_something = false;
+  }
+
+  return did_something;
+}
+
+void BoundedCallQueue::close ()
+{
+  m_closed.signal ();
+
+  synchronize ();
+}
+
+// Calls are processed in place, and the cell is handed back to the
+// producers afterwards. A cell which was claimed by a producer but not
+// yet published stops the loop. Producers only signal on the transition
+// of the count from zero, so if calls are still counted when we stop, we
+// mark the queue as stalled and look once more. Either we find the call,
+// or its producer sees the mark after publishing and signals for us.
+//
+bool BoundedCallQueue::doSynchronize ()
+{
+  bool did_something = false;
+  bool stalled = false;
+
+  reset ();
+
+  for (;;)
+  {
+    Call* const call = m_calls.acquirePop ();
+
+    if (call == nullptr)
+    {
+      if (stalled || m_numberOfPendingCalls.get () == 0)
+        break;
+
+      m_isStalled.trySignal ();
+      stalled = true;
+
+      continue;
+    }
+
+    stalled = false;
+    did_something = true;
+
+    call->m_function (*call, true);
+
+    m_calls.commitPop (call);
+
+    --m_numberOfPendingCalls;
+  }
+
+  return did_something;
+}
@@ -0,0 +1,385 @@
+/*============================================================================*/
+/*
+  VFLib: https://github.com/vinniefalco/VFLib
+
+  Copyright (C) 2008 by Vinnie Falco <vinnie.falco@gmail.com>
+
+  This library contains portions of other open source products covered by
+  separate licenses. Please see the corresponding source files for specific
+  terms.
+  
+  VFLib is provided under the terms of The MIT License (MIT):
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+  IN THE SOFTWARE.
+*/
+/*============================================================================*/
+
+#ifndef VF_BOUNDEDCALLQUEUE_VFHEADER
+#define VF_BOUNDEDCALLQUEUE_VFHEADER
+
+/*============================================================================*/
+/** 
+  A CallQueue with fixed storage for its functors.
+
+  This works like CallQueue, but functors are stored in the cells of a
+  BoundedLockFreeQueue instead of in separately allocated Work objects. A
+  functor which fits in a cell, such as the result of a bind() with a few
+  parameters, is copied into the cell, so calling it requires no allocation
+  at all. Larger functors are allocated as usual, and the cell holds a
+  pointer to them. When synchronized, functors are called in place.
+
+  The consumer never waits for a producer that is in the middle of adding a
+  functor. If the oldest functor is still being added, synchronize() returns,
+  and the queue is signaled again once the functor has been added.
+
+  The queue holds a fixed number of functors. When it is full, call() and
+  queue() return `false` and the functor is not added. There are no priority
+  lanes and no overflow policies; use CallQueue for those.
+
+  Like CallQueue, this is an abstract class. Derived classes implement
+  signal() and reset(), and call synchronize().
+
+  @see CallQueue, BoundedLockFreeQueue
+
+  @ingroup vf_concurrent
+*/
+class BoundedCallQueue
+{
+public:
+  /** Type of allocator to use for functors which do not fit in a cell.
+
+      @internal
+  */
+  typedef FifoFreeStoreType AllocatorType;
+
+  enum
+  {
+    /** The largest functor which is stored without allocating. Functors
+        which need a stricter alignment than a double are always allocated.
+    */
+    inlineBytes = 48
+  };
+
+  /** Create the queue.
+
+      The queue starts out open and empty.
+
+      @param name     A string to identify the queue during debugging.
+
+      @param capacity The number of functors the queue can hold. It is rounded
+                      up to a power of two.
+  */
+  BoundedCallQueue (String name, int capacity);
+
+  /** Destroy the queue.
+
+      @invariant Destroying a queue that contains functors results in undefined
+                 behavior.
+  */
+  virtual ~BoundedCallQueue ();
+
+  //============================================================================
+
+  /** Add a functor and possibly synchronize.
+
+      If the current thread of execution is the same as the thread associated
+      with the queue, synchronize() is called automatically.
+
+      @param f The functor to add, typically the return value of a call
+               to bind().
+
+      @return `false` if the queue was full and the functor was rejected.
+  */
+  template <class Functor>
+  bool callf (Functor const& f)
+  {
+    if (! queuef (f))
+      return false;
+
+    if (isAssociatedWithCurrentThread () && m_isBeingSynchronized.trySignal ())
+    {
+      doSynchronize ();
+
+      m_isBeingSynchronized.reset ();
+    }
+
+    return true;
+  }
+
+  /** Add a functor without synchronizing.
+
+      @param f The functor to add.
+
+      @return `false` if the queue was full and the functor was rejected.
+  */
+  template <class Functor>
+  bool queuef (Functor const& f)
+  {
+    // If this goes off it means calls are being made after the
+    // queue is closed, and probably there is no one around to
+    // process it.
+    jassert (!m_closed.isSignaled ());
+
+    Call* const call = m_calls.acquirePush ();
+
+    if (call == nullptr)
+      return false;
+
+    if (sizeof (Functor) <= inlineBytes &&
+        AlignmentOf <Functor>::value <= AlignmentOf <Storage>::value)
+    {
+      new (call->m_storage.m_bytes) Functor (f);
+      call->m_function = &callInline <Functor>;
+    }
+    else
+    {
+      // If this goes off, the functor needs a stricter alignment
+      // than the allocator provides.
+      jassert (AlignmentOf <Functor>::value <= Memory::allocAlignBytes);
+
+      call->m_storage.m_pointer = new (m_allocator) AllocatedCall <Functor> (f);
+      call->m_function = &callAllocated <Functor>;
+    }
+
+    m_calls.commitPush (call);
+
+    // Count after publishing, so the consumer can never
+    // see the count without being able to find the call.
+    // A consumer which stopped at this call while it was
+    // being added needs a signal to come back for it.
+    if (++m_numberOfPendingCalls == 1 ||
+        (m_isStalled.isSignaled () && m_isStalled.tryReset ()))
+      signal ();
+
+    return true;
+  }
+
+  /** Add a function call and possibly synchronize.
+
+      Parameters are evaluated immediately and added to the queue as a packaged
+      functor.
+
+      @see CallQueue::call
+  */
+  /** @{ */
+  template <class Fn>
+  bool call (Fn f)
+  { return callf (vf::bind (f)); }
+
+  template <class Fn, class T1>
+  bool call (Fn f, T1 t1)
+  { return callf (vf::bind (f, t1)); }
+
+  template <class Fn, class T1, class T2>
+  bool call (Fn f, T1 t1, T2 t2)
+  { return callf (vf::bind (f, t1, t2)); }
+
+  template <class Fn, class T1, class T2, class T3>
+  bool call (Fn f, T1 t1, T2 t2, T3 t3)
+  { return callf (vf::bind (f, t1, t2, t3)); }
+
+  template <class Fn, class T1, class T2, class T3, class T4>
+  bool call (Fn f, T1 t1, T2 t2, T3 t3, T4 t4)
+  { return callf (vf::bind (f, t1, t2, t3, t4)); }
+
+  template <class Fn, class T1, class T2, class T3, class T4, class T5>
+  bool call (Fn f, T1 t1, T2 t2, T3 t3, T4 t4, T5 t5)
+  { return callf (vf::bind (f, t1, t2, t3, t4, t5)); }
+
+  template <class Fn, class T1, class T2, class T3, class T4, class T5, class T6>
+  bool call (Fn f, T1 t1, T2 t2, T3 t3, T4 t4, T5 t5, T6 t6)
+  { return callf (vf::bind (f, t1, t2, t3, t4, t5, t6)); }
+
+  template <class Fn, class T1, class T2, class T3, class T4, class T5, class T6, class T7>
+  bool call (Fn f, T1 t1, T2 t2, T3 t3, T4 t4, T5 t5, T6 t6, T7 t7)
+  { return callf (vf::bind (f, t1, t2, t3, t4, t5, t6, t7)); }
+
+  template <class Fn, class T1, class T2, class T3, class T4, class T5, class T6, class T7, class T8>
+  bool call (Fn f, T1 t1, T2 t2, T3 t3, T4 t4, T5 t5, T6 t6, T7 t7, T8 t8)
+  { return callf (vf::bind (f, t1, t2, t3, t4, t5, t6, t7, t8)); }
+  /** @} */
+
+  /** Add a function call without synchronizing.
+
+      @see CallQueue::queue
+  */
+  /** @{ */
+  template <class Fn>
+  bool queue (Fn f)
+  { return queuef (vf::bind (f)); }
+
+  template <class Fn, class T1>
+  bool queue (Fn f, T1 t1)
+  { return queuef (vf::bind (f, t1)); }
+
+  template <class Fn, class T1, class T2>
+  bool queue (Fn f, T1 t1, T2 t2)
+  { return queuef (vf::bind (f, t1, t2)); }
+
+  template <class Fn, class T1, class T2, class T3>
+  bool queue (Fn f, T1 t1, T2 t2, T3 t3)
+  { return queuef (vf::bind (f, t1, t2, t3)); }
+
+  template <class Fn, class T1, class T2, class T3, class T4>
+  bool queue (Fn f, T1 t1, T2 t2, T3 t3, T4 t4)
+  { return queuef (vf::bind (f, t1, t2, t3, t4)); }
+
+  template <class Fn, class T1, class T2, class T3, class T4, class T5>
+  bool queue (Fn f, T1 t1, T2 t2, T3 t3, T4 t4, T5 t5)
+  { return queuef (vf::bind (f, t1, t2, t3, t4, t5)); }
+
+  template <class Fn, class T1, class T2, class T3, class T4, class T5, class T6>
+  bool queue (Fn f, T1 t1, T2 t2, T3 t3, T4 t4, T5 t5, T6 t6)
+  { return queuef (vf::bind (f, t1, t2, t3, t4, t5, t6)); }
+
+  template <class Fn, class T1, class T2, class T3, class T4, class T5, class T6, class T7>
+  bool queue (Fn f, T1 t1, T2 t2, T3 t3, T4 t4, T5 t5, T6 t6, T7 t7)
+  { return queuef (vf::bind (f, t1, t2, t3, t4, t5, t6, t7)); }
+
+  template <class Fn, class T1, class T2, class T3, class T4, class T5, class T6, class T7, class T8>
+  bool queue (Fn f, T1 t1, T2 t2, T3 t3, T4 t4, T5 t5, T6 t6, T7 t7, T8 t8)
+  { return queuef (vf::bind (f, t1, t2, t3, t4, t5, t6, t7, t8)); }
+  /** @} */
+
+  /** Retrieve the name of the queue.
+
+      @return The name of the queue.
+  */
+  String const& getName () const { return m_name; }
+
+  /** Determine if the caller is on the associated thread.
+
+      The associated thread is the one which last called synchronize().
+  */
+  bool isAssociatedWithCurrentThread () const;
+
+  /** Determine the number of functors in the queue.
+
+      The value may be out of date as soon as it is returned.
+  */
+  int getNumberOfPendingCalls () const { return m_numberOfPendingCalls.get (); }
+
+protected:
+  /** Synchronize the queue.
+
+      All functors in the queue are called, including ones added by the
+      functors themselves. Calling this function from more than one thread
+      simultaneously is undefined.
+
+      @return `true` if any functors were executed.
+  */
+  bool synchronize ();
+
+  /** Close the queue.
+
+      Functors may not be added after this routine is called. The queue is
+      synchronized after it is closed.
+  */
+  void close ();
+
+  /** Called when the queue becomes signaled.
+
+      @see CallQueue::signal
+  */
+  virtual void signal () = 0;
+
+  /** Called when the queue is reset.
+
+      @see CallQueue::reset
+  */
+  virtual void reset () = 0;
+
+private:
+  union Storage
+  {
+    char m_bytes [inlineBytes];
+    void* m_pointer;
+    double m_double;
+    int64 m_int64;
+  };
+
+  struct Call
+  {
+    void (*m_function) (Call& call, bool invoke);
+
+    Storage m_storage;
+  };
+
+  // The alignment of a type, from the padding placed in front of it.
+  //
+  template <class T>
+  struct AlignmentOf
+  {
+    struct Probe
+    {
+      char m_char;
+      T m_t;
+    };
+
+    enum
+    {
+      value = sizeof (Probe) - sizeof (T)
+    };
+  };
+
+  template <class Functor>
+  struct AllocatedCall : AllocatedBy <AllocatorType>
+  {
+    explicit AllocatedCall (Functor const& f) : m_f (f) { }
+
+    Functor m_f;
+  };
+
+  template <class Functor>
+  static void callInline (Call& call, bool invoke)
+  {
+    Functor* const f = reinterpret_cast <Functor*> (call.m_storage.m_bytes);
+
+    if (invoke)
+      (*f) ();
+
+    f->~Functor ();
+  }
+
+  template <class Functor>
+  static void callAllocated (Call& call, bool invoke)
+  {
+    AllocatedCall <Functor>* const c =
+      static_cast <AllocatedCall <Functor>*> (call.m_storage.m_pointer);
+
+    if (invoke)
+      c->m_f ();
+
+    delete c;
+  }
+
+  bool doSynchronize ();
+
+private:
+  String const m_name;
+  Thread::ThreadID m_id;
+  BoundedLockFreeQueue <Call> m_calls;
+  Atomic <int> m_numberOfPendingCalls;
+  AtomicFlag m_closed;
+  AtomicFlag m_isBeingSynchronized;
+  AtomicFlag m_isStalled;
+  AllocatorType m_allocator;
+};
+
+#endif
@@ -32,6 +32,9 @@
 
 CallQueue::CallQueue (String name)
   : m_name (name)
+  , m_capacity (0)
+  , m_overflowPolicy (overflowBlock)
+  , m_spaceAvailable (false) // auto-reset
 {
 }
 
@@ -41,7 +44,7 @@ CallQueue::~CallQueue ()
   jassert (m_closed.isSignaled ());
 
   // Can't destroy queue with unprocessed calls.
-  jassert (m_queue.empty ());
+  jassert (empty ());
 }
 
 bool CallQueue::isAssociatedWithCurrentThread () const
@@ -49,25 +52,139 @@ bool CallQueue::isAssociatedWithCurrentThread () const
   return Thread::getCurrentThreadId () == m_id;
 }
 
+void CallQueue::setCapacity (int capacity, OverflowPolicy policy)
+{
+  jassert (capacity >= 0);
+
+  m_capacity = capacity;
+  m_overflowPolicy = policy;
+}
+
 // Adds a call to the queue of execution.
-void CallQueue::queuep (Work* c)
+bool CallQueue::queuep (Work* c, Priority priority)
 {
   // If this goes off it means calls are being made after the
   // queue is closed, and probably there is no one around to
   // process it.
   jassert (!m_closed.isSignaled ());
 
-  if (m_queue.push_back (c))
-    signal ();
+  bool const reserved = reserve ();
+
+  if (reserved)
+  {
+#if VF_USE_CALLQUEUE_STATISTICS
+    m_statistics.updateMaximumDepth (m_numberOfPendingCalls.get ());
+
+    c->m_enqueueTicks = Time::getHighResolutionTicks ();
+#endif
+
+    if (m_queues [priority].push_back (c))
+      signal ();
+  }
+  else
+  {
+    delete c;
+  }
+
+  return reserved;
+}
+
+// Count the call as pending, applying the overflow policy if the queue
+// is full. Returns false if the call must be rejected.
+//
+bool CallQueue::reserve ()
+{
+  if (m_capacity == 0)
+  {
+    ++m_numberOfPendingCalls;
+
+    return true;
+  }
+
+  if (m_overflowPolicy == overflowDropOldest)
+  {
+    // The associated thread is synchronizing, which drops stale calls.
+    if (++m_numberOfPendingCalls <= m_capacity || isAssociatedWithCurrentThread ())
+      return true;
+
+    // Make room by discarding the oldest call. That takes the consumer's
+    // side of the queue, so it is only possible when nobody is
+    // synchronizing.
+    //
+    if (m_isBeingSynchronized.trySignal ())
+    {
+      bool const discarded = discardOldest ();
+
+      m_isBeingSynchronized.reset ();
+
+      // A synchronize() that ran into us did nothing, so make
+      // sure the consumer comes back for the rest.
+      //
+      signal ();
+
+      if (discarded)
+        return true;
+    }
+
+    --m_numberOfPendingCalls;
+
+    ++m_numberOfFailedCalls;
+
+    return false;
+  }
+
+  bool blocked = false;
+
+  for (;;)
+  {
+    if (++m_numberOfPendingCalls <= m_capacity)
+      break;
+
+    --m_numberOfPendingCalls;
+
+    if (m_overflowPolicy == overflowFail)
+    {
+      ++m_numberOfFailedCalls;
+
+      return false;
+    }
+
+    // The associated thread cannot wait for itself.
+    if (isAssociatedWithCurrentThread ())
+    {
+      ++m_numberOfPendingCalls;
+      break;
+    }
+
+    if (! blocked)
+    {
+      blocked = true;
+
+      ++m_numberOfBlockedCalls;
+    }
+
+    // Announce ourselves before checking again, so that the consumer
+    // either sees us waiting or we see the space it made.
+    //
+    ++m_numberOfWaitingProducers;
+
+    if (m_numberOfPendingCalls.get () >= m_capacity)
+      m_spaceAvailable.wait ();
+
+    --m_numberOfWaitingProducers;
+  }
+
+  return true;
 }
 
 // Append the Work to the queue. If this call is made from the same
 // thread as the last thread that called synchronize(), then the call
 // will execute synchronously.
 //
-void CallQueue::callp (Work* c)
+bool CallQueue::callp (Work* c, Priority priority)
 {
-  queuep (c);
+  if (! queuep (c, priority))
+    return false;
 
   // If we are called on the process thread and we are not
   // recursed into doSynchronize, then process the queue. This
@@ -87,6 +204,8 @@ void CallQueue::callp (Work* c)
 
     m_isBeingSynchronized.reset ();
   }
+
+  return true;
 }
 
 bool CallQueue::synchronize ()
@@ -113,6 +232,28 @@ bool CallQueue::synchronize ()
   return did_something;
 }
 
+int CallQueue::synchronize (int maxCalls, int maxMicroseconds)
+{
+  jassert (maxCalls >= -1);
+
+  // doSynchronize() checks the budget after each call, so it
+  // would always make at least one.
+  //
+  if (maxCalls == 0)
+    return m_numberOfPendingCalls.get ();
+
+  if (m_isBeingSynchronized.trySignal ())
+  {
+    m_id = Thread::getCurrentThreadId ();
+
+    doSynchronize (maxCalls, maxMicroseconds);
+
+    m_isBeingSynchronized.reset ();
+  }
+
+  return m_numberOfPendingCalls.get ();
+}
+
 // Can still have pending calls, just can't put new ones in.
 void CallQueue::close ()
 {
@@ -121,13 +262,24 @@ void CallQueue::close ()
   synchronize ();
 }
 
-// Process everything in the queue. The list of pending calls is
-// acquired atomically. New calls may enter the queue while we are
-// processing.
+// Taking the functor resets the key, so the next
+// callLatest() for it will queue another LatestCall.
+//
+void CallQueue::LatestCall::operator() ()
+{
+  Work* const work = m_key.m_pending.exchange (nullptr);
+
+  work->operator() ();
+  delete work;
+}
+
+// Process everything in the queue, or until the budget runs out. The list
+// of pending calls is acquired atomically. New calls may enter the queue
+// while we are processing.
 //
 // Returns true if any functors were called.
 //
-bool CallQueue::doSynchronize ()
+bool CallQueue::doSynchronize (int maxCalls, int maxMicroseconds)
 {
   bool did_something;
 
@@ -137,21 +289,75 @@ bool CallQueue::doSynchronize ()
   //
   reset ();
 
-  Work* call = m_queue.pop_front ();
+  Work* call = popFront ();
 
   if (call)
   {
     did_something = true;
 
+    int64 const startTicks = (maxMicroseconds != -1) ?
+      Time::getHighResolutionTicks () : 0;
+
+    int64 const maxTicks = (maxMicroseconds != -1) ?
+      (Time::getHighResolutionTicksPerSecond () * maxMicroseconds) / 1000000 : 0;
+
+    int numberOfCalls = 0;
+
     // This method of processing one at a time has the desired
     // side effect of synchronizing nested calls to us from a functor.
     //
     for (;;)
     {
-      call->operator() ();
-      delete call;
+      int const numberOfNewerCalls = --m_numberOfPendingCalls;
+
+      if (m_numberOfWaitingProducers.get () > 0)
+        m_spaceAvailable.signal ();
+
+      if (m_capacity != 0 &&
+          m_overflowPolicy == overflowDropOldest &&
+          numberOfNewerCalls >= m_capacity &&
+          call->canDiscard ())
+      {
+        // Too many newer calls are behind this one, so it is stale.
+        ++m_numberOfDroppedCalls;
 
-      call = m_queue.pop_front ();
+        delete call;
+      }
+      else
+      {
+#if VF_USE_CALLQUEUE_STATISTICS
+        int64 const callTicks = Time::getHighResolutionTicks ();
+
+        m_statistics.m_latency.add (ticksToMicroseconds (callTicks - call->m_enqueueTicks));
+#endif
+
+        call->operator() ();
+
+#if VF_USE_CALLQUEUE_STATISTICS
+        m_statistics.m_executionTime.add (ticksToMicroseconds (
+          Time::getHighResolutionTicks () - callTicks));
+#endif
+
+        delete call;
+      }
+
+      ++numberOfCalls;
+
+      if ((maxCalls != -1 && numberOfCalls >= maxCalls) ||
+          (maxMicroseconds != -1 &&
+           Time::getHighResolutionTicks () - startTicks >= maxTicks))
+      {
+        // Out of budget. We reset the queue at the start, and a producer
+        // only signals on the transition from empty, so signal again to
+        // make sure the remaining calls get processed.
+        //
+        if (! empty ())
+          signal ();
+
+        break;
+      }
+
+      call = popFront ();
       if (call == 0)
         break;
     }
@@ -163,3 +369,139 @@ bool CallQueue::doSynchronize ()
 
   return did_something;
 }
+
+// Take the next call from the lane with the highest priority. Since this
+// is called after every functor, a call to a higher priority lane made
+// during synchronization runs before the rest of a lower priority lane.
+//
+// Each lane is drained in batches. Whatever is fully linked into the lane
+// is detached into a private backlog in one pass, and calls are then taken
+// from the backlog without touching shared memory. Only the newest call in
+// a lane goes through pop_front (), which may have to wait for a producer.
+//
+CallQueue::Work* CallQueue::popFront ()
+{
+  Work* call = nullptr;
+
+  for (int i = 0; i < numberOfPriorities && call == nullptr; ++i)
+    call = popFront (i);
+
+  return call;
+}
+
+CallQueue::Work* CallQueue::popFront (int priority)
+{
+  Work* call = m_backlog [priority].pop_front ();
+
+  if (call == nullptr)
+  {
+    m_backlog [priority] = m_queues [priority].detach ();
+
+    call = m_backlog [priority].pop_front ();
+
+    if (call == nullptr)
+      call = m_queues [priority].pop_front ();
+  }
+
+  return call;
+}
+
+// Delete the oldest call which can be discarded, looking at the lowest
+// priority lane first. Calls which must run are put back in their original
+// order. Only the consumer may call this.
+//
+// Returns true if a call was discarded.
+//
+bool CallQueue::discardOldest ()
+{
+  for (int i = numberOfPriorities; --i >= 0;)
+  {
+    LockFreeQueue <Work>::Chain kept;
+
+    Work* call;
+
+    for (;;)
+    {
+      call = popFront (i);
+
+      if (call == nullptr || call->canDiscard ())
+        break;
+
+      kept.push_front (call);
+    }
+
+    while (! kept.empty ())
+      m_backlog [i].push_front (kept.pop_front ());
+
+    if (call != nullptr)
+    {
+      --m_numberOfPendingCalls;
+
+      ++m_numberOfDroppedCalls;
+
+      delete call;
+
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool CallQueue::empty () const
+{
+  for (int i = 0; i < numberOfPriorities; ++i)
+    if (! m_backlog [i].empty () || ! m_queues [i].empty ())
+      return false;
+
+  return true;
+}
+
+//------------------------------------------------------------------------------
+
+#if VF_USE_CALLQUEUE_STATISTICS
+
+CallQueue::Histogram::Histogram ()
+{
+}
+
+void CallQueue::Histogram::add (int64 microseconds)
+{
+  int bucket = 0;
+
+  while (bucket < numberOfBuckets - 1 && microseconds >= getBucketLimit (bucket))
+    ++bucket;
+
+  ++m_counts [bucket];
+}
+
+int CallQueue::Histogram::getCount (int bucket) const
+{
+  jassert (bucket >= 0 && bucket < numberOfBuckets);
+
+  return m_counts [bucket].get ();
+}
+
+int64 CallQueue::Histogram::getBucketLimit (int bucket)
+{
+  return int64 (1) << bucket;
+}
+
+void CallQueue::Statistics::updateMaximumDepth (int depth)
+{
+  for (;;)
+  {
+    int const maximumDepth = m_maximumDepth.get ();
+
+    if (depth <= maximumDepth ||
+        m_maximumDepth.compareAndSetBool (depth, maximumDepth))
+      break;
+  }
+}
+
+int64 CallQueue::ticksToMicroseconds (int64 ticks)
+{
+  return (ticks * 1000000) / Time::getHighResolutionTicksPerSecond ();
+}
+
+#endif
@@ -126,8 +126,8 @@
   @invariant The thread from which synchronize() is called is considered the
               thread associated with the CallQueue.
 
-  @invariant Functors queued by the same thread always execute in the same
-              order they were queued.
+  @invariant Functors queued by the same thread with the same priority always
+              execute in the same order they were queued.
 
   @invariant Functors are guaranteed to execute. It is an error if the
               CallQueue is deleted while there are functors in it.
@@ -155,6 +155,23 @@ public:
   */
   typedef FifoFreeStoreType AllocatorType;
 
+  /** Priority lanes.
+
+      Each priority has its own lane. When the queue is synchronized, a
+      functor is only called when the lanes of higher priority are empty,
+      so control messages are not held up behind a backlog of housekeeping
+      work. Functors in the same lane which are queued by the same thread
+      always execute in the order they were queued.
+  */
+  enum Priority
+  {
+    priorityHigh,
+    priorityNormal,
+    priorityLow,
+
+    numberOfPriorities
+  };
+
   /** Abstract nullary functor in a @ref CallQueue.
 
       Custom implementations may derive from this object for efficiency instead
@@ -171,6 +188,38 @@ public:
         This executes during the queue's call to synchronize().
     */
     virtual void operator() () = 0;
+
+    /** Determine if the functor may be discarded without being called.
+
+        When a queue with the overflowDropOldest policy falls behind, old
+        functors are deleted without being called. Work which must always
+        run, such as work which somebody is waiting for, overrides this to
+        return `false`.
+    */
+    virtual bool canDiscard () const { return true; }
+
+#if VF_USE_CALLQUEUE_STATISTICS
+  private:
+    friend class CallQueue;
+
+    int64 m_enqueueTicks;
+#endif
+  };
+
+  /** What happens when a bounded queue is full.
+
+      @see setCapacity
+  */
+  enum OverflowPolicy
+  {
+    /** The producer waits until there is room in the queue. */
+    overflowBlock,
+
+    /** The functor is rejected, and the call returns `false`. */
+    overflowFail,
+
+    /** The functor is added, and the oldest functor is discarded. */
+    overflowDropOldest
   };
 
   //============================================================================
@@ -199,15 +248,43 @@ public:
 
       Use this when you want to perform the bind yourself.
 
-      @param f The functor to add, typically the return value of a call
-               to bind().
+      @param f        The functor to add, typically the return value of a
+                      call to bind().
+
+      @param priority The lane to add the functor to.
+
+      @return `false` if the queue was full and the functor was rejected.
 
       @see call
   */
   template <class Functor>
-  void callf (Functor const& f)
+  bool callf (Functor const& f, Priority priority = priorityNormal)
   {
-    callp (new (m_allocator) CallType <Functor> (f));
+    return callp (new (m_allocator) CallType <Functor> (f), priority);
+  }
+
+  /** Add a cancellable functor and possibly synchronize.
+
+      If the token is cancelled before the functor comes out of the queue,
+      the functor is deleted without being called.
+
+      @param token    The token which can cancel the call. It must outlive
+                      the call.
+
+      @param f        The functor to add.
+
+      @param priority The lane to add the functor to.
+
+      @return `false` if the queue was full and the functor was rejected.
+
+      @see CancellationToken
+  */
+  template <class Functor>
+  bool callf (CancellationToken const& token,
+              Functor const& f,
+              Priority priority = priorityNormal)
+  {
+    return callp (new (m_allocator) CancellableCallType <Functor> (token, f), priority);
   }
 
   /** Add a function call and possibly synchronize.
@@ -228,57 +305,57 @@ public:
   */
   /** @{ */
   template <class Fn>
-  void call (Fn f)
+  bool call (Fn f)
   {
-    callf (vf::bind (f));
+    return callf (vf::bind (f));
   }
 
   template <class Fn, class T1>
-  void call (Fn f, T1 t1)
+  bool call (Fn f, T1 t1)
   {
-    callf (vf::bind (f, t1));
+    return callf (vf::bind (f, t1));
   }
 
   template <class Fn, class T1, class T2>
-  void call (Fn f, T1 t1, T2 t2)
+  bool call (Fn f, T1 t1, T2 t2)
   {
-    callf (vf::bind (f, t1, t2));
+    return callf (vf::bind (f, t1, t2));
   }
 
   template <class Fn, class T1, class T2, class T3>
-  void call (Fn f, T1 t1, T2 t2, T3 t3)
+  bool call (Fn f, T1 t1, T2 t2, T3 t3)
   {
-    callf (vf::bind (f, t1, t2, t3));
+    return callf (vf::bind (f, t1, t2, t3));
   }
 
   template <class Fn, class T1, class T2, class T3, class T4>
-  void call (Fn f, T1 t1, T2 t2, T3 t3, T4 t4)
+  bool call (Fn f, T1 t1, T2 t2, T3 t3, T4 t4)
   {
-    callf (vf::bind (f, t1, t2, t3, t4));
+    return callf (vf::bind (f, t1, t2, t3, t4));
   }
 
   template <class Fn, class T1, class T2, class T3, class T4, class T5>
-  void call (Fn f, T1 t1, T2 t2, T3 t3, T4 t4, T5 t5)
+  bool call (Fn f, T1 t1, T2 t2, T3 t3, T4 t4, T5 t5)
   {
-    callf (vf::bind (f, t1, t2, t3, t4, t5));
+    return callf (vf::bind (f, t1, t2, t3, t4, t5));
   }
 
   template <class Fn, class T1, class T2, class T3, class T4, class T5, class T6>
-  void call (Fn f, T1 t1, T2 t2, T3 t3, T4 t4, T5 t5, T6 t6)
+  bool call (Fn f, T1 t1, T2 t2, T3 t3, T4 t4, T5 t5, T6 t6)
   {
-    callf (vf::bind (f, t1, t2, t3, t4, t5, t6));
+    return callf (vf::bind (f, t1, t2, t3, t4, t5, t6));
   }
 
   template <class Fn, class T1, class T2, class T3, class T4, class T5, class T6, class T7>
-  void call (Fn f, T1 t1, T2 t2, T3 t3, T4 t4, T5 t5, T6 t6, T7 t7)
+  bool call (Fn f, T1 t1, T2 t2, T3 t3, T4 t4, T5 t5, T6 t6, T7 t7)
   {
-    callf (vf::bind (f, t1, t2, t3, t4, t5, t6, t7));
+    return callf (vf::bind (f, t1, t2, t3, t4, t5, t6, t7));
   }
 
   template <class Fn, class T1, class T2, class T3, class T4, class T5, class T6, class T7, class T8>
-  void call (Fn f, T1 t1, T2 t2, T3 t3, T4 t4, T5 t5, T6 t6, T7 t7, T8 t8)
+  bool call (Fn f, T1 t1, T2 t2, T3 t3, T4 t4, T5 t5, T6 t6, T7 t7, T8 t8)
   {
-    callf (vf::bind (f, t1, t2, t3, t4, t5, t6, t7, t8));
+    return callf (vf::bind (f, t1, t2, t3, t4, t5, t6, t7, t8));
   }
   /** @} */
 
@@ -286,15 +363,31 @@ public:
 
       Use this when you want to perform the bind yourself.
 
-      @param f The functor to add, typically the return value of a call
-                to bind().
+      @param f        The functor to add, typically the return value of a
+                      call to bind().
+
+      @param priority The lane to add the functor to.
+
+      @return `false` if the queue was full and the functor was rejected.
 
       @see queue
   */
   template <class Functor>
-  void queuef (Functor f)
+  bool queuef (Functor f, Priority priority = priorityNormal)
+  {
+    return queuep (new (m_allocator) CallType <Functor> (f), priority);
+  }
+
+  /** Add a cancellable functor without synchronizing.
+
+      @see callf, CancellationToken
+  */
+  template <class Functor>
+  bool queuef (CancellationToken const& token,
+               Functor const& f,
+               Priority priority = priorityNormal)
   {
-    queuep (new (m_allocator) CallType <Functor> (f));
+    return queuep (new (m_allocator) CancellableCallType <Functor> (token, f), priority);
   }
 
   /** Add a function call without synchronizing.
@@ -342,60 +435,294 @@ public:
   */
   /** @{ */
   template <class Fn>
-  void queue (Fn f)
+  bool queue (Fn f)
   {
-    queuef (vf::bind (f));
+    return queuef (vf::bind (f));
   }
 
   template <class Fn, class T1>
-  void queue (Fn f, T1 t1)
+  bool queue (Fn f, T1 t1)
   {
-    queuef (vf::bind (f, t1));
+    return queuef (vf::bind (f, t1));
   }
 
   template <class Fn, class T1, class T2>
-  void queue (Fn f, T1 t1, T2 t2)
+  bool queue (Fn f, T1 t1, T2 t2)
   {
-    queuef (vf::bind (f, t1, t2));
+    return queuef (vf::bind (f, t1, t2));
   }
 
   template <class Fn, class T1, class T2, class T3>
-  void queue (Fn f, T1 t1, T2 t2, T3 t3)
+  bool queue (Fn f, T1 t1, T2 t2, T3 t3)
   {
-    queuef (vf::bind (f, t1, t2, t3));
+    return queuef (vf::bind (f, t1, t2, t3));
   }
 
   template <class Fn, class T1, class T2, class T3, class T4>
-  void queue (Fn f, T1 t1, T2 t2, T3 t3, T4 t4)
+  bool queue (Fn f, T1 t1, T2 t2, T3 t3, T4 t4)
   {
-    queuef (vf::bind (f, t1, t2, t3, t4));
+    return queuef (vf::bind (f, t1, t2, t3, t4));
   }
 
   template <class Fn, class T1, class T2, class T3, class T4, class T5>
-  void queue (Fn f, T1 t1, T2 t2, T3 t3, T4 t4, T5 t5)
+  bool queue (Fn f, T1 t1, T2 t2, T3 t3, T4 t4, T5 t5)
   {
-    queuef (vf::bind (f, t1, t2, t3, t4, t5));
+    return queuef (vf::bind (f, t1, t2, t3, t4, t5));
   }
 
   template <class Fn, class T1, class T2, class T3, class T4, class T5, class T6>
-  void queue (Fn f, T1 t1, T2 t2, T3 t3, T4 t4, T5 t5, T6 t6)
+  bool queue (Fn f, T1 t1, T2 t2, T3 t3, T4 t4, T5 t5, T6 t6)
   {
-    queuef (vf::bind (f, t1, t2, t3, t4, t5, t6));
+    return queuef (vf::bind (f, t1, t2, t3, t4, t5, t6));
   }
 
   template <class Fn, class T1, class T2, class T3, class T4, class T5, class T6, class T7>
-  void queue (Fn f, T1 t1, T2 t2, T3 t3, T4 t4, T5 t5, T6 t6, T7 t7)
+  bool queue (Fn f, T1 t1, T2 t2, T3 t3, T4 t4, T5 t5, T6 t6, T7 t7)
   {
-    queuef (vf::bind (f, t1, t2, t3, t4, t5, t6, t7));
+    return queuef (vf::bind (f, t1, t2, t3, t4, t5, t6, t7));
   }
 
   template <class Fn, class T1, class T2, class T3, class T4, class T5, class T6, class T7, class T8>
-  void queue (Fn f, T1 t1, T2 t2, T3 t3, T4 t4, T5 t5, T6 t6, T7 t7, T8 t8)
+  bool queue (Fn f, T1 t1, T2 t2, T3 t3, T4 t4, T5 t5, T6 t6, T7 t7, T8 t8)
   {
-    queuef (vf::bind (f, t1, t2, t3, t4, t5, t6, t7, t8));
+    return queuef (vf::bind (f, t1, t2, t3, t4, t5, t6, t7, t8));
   }
   /** @} */
 
+  //============================================================================
+
+  /** Identifies a coalesced call.
+
+      Each key holds at most one pending functor for callLatest(). Declare
+      one key for each stream of values where only the newest one matters,
+      for example the play position shown on the display. A key must only be
+      used with one queue, and it must outlive any pending call made with it.
+  */
+  class CoalescingKey : Uncopyable
+  {
+  public:
+    CoalescingKey () { }
+
+    ~CoalescingKey ()
+    {
+      // If this goes off, the key was destroyed with a call still pending.
+      jassert (m_pending.get () == nullptr);
+    }
+
+  private:
+    friend class CallQueue;
+
+    AtomicPointer <Work> m_pending;
+  };
+
+  /** Add a functor which replaces the previous one for the same key.
+
+      When there is already a pending functor for the key, it is atomically
+      replaced and deleted without being called. Otherwise the functor is
+      added like callf(). No matter how many functors are added between two
+      synchronizations, the queue holds at most one entry for each key, and
+      only the newest functor is called.
+
+      If the queue rejects the call while a newer functor has already
+      replaced this one, the newer functor was accepted, so the call is
+      retried on its behalf until the queue takes it.
+
+      @param key The key which identifies the coalesced call.
+
+      @param f   The functor to add.
+
+      @return `false` if the queue was full and the functor was rejected.
+
+      @see callLatest
+  */
+  template <class Functor>
+  bool callLatestf (CoalescingKey& key, Functor const& f)
+  {
+    Work* const work = new (m_allocator) CallType <Functor> (f);
+
+    Work* const old = key.m_pending.exchange (work);
+
+    if (old != nullptr)
+    {
+      // A call for the key is already in the queue.
+      delete old;
+
+      return true;
+    }
+
+    if (callp (new (m_allocator) LatestCall (key)))
+      return true;
+
+    // The queue is full. Take the functor back, unless another
+    // producer replaced it after seeing the call as queued.
+    //
+    if (key.m_pending.compareAndSet (nullptr, work))
+    {
+      delete work;
+
+      return false;
+    }
+
+    SpinDelay delay;
+
+    while (! callp (new (m_allocator) LatestCall (key)))
+      delay.pause ();
+
+    return true;
+  }
+
+  /** Add a function call which replaces the previous one for the same key.
+
+      @code
+
+      CallQueue::CoalescingKey positionKey;
+
+      void positionChanged (double seconds)
+      {
+        guiQueue.callLatest (positionKey, &Display::setPosition, display, seconds);
+      }
+
+      @endcode
+
+      @see callLatestf
+  */
+  /** @{ */
+  template <class Fn>
+  bool callLatest (CoalescingKey& key, Fn f)
+  { return callLatestf (key, vf::bind (f)); }
+
+  template <class Fn, class T1>
+  bool callLatest (CoalescingKey& key, Fn f, T1 t1)
+  { return callLatestf (key, vf::bind (f, t1)); }
+
+  template <class Fn, class T1, class T2>
+  bool callLatest (CoalescingKey& key, Fn f, T1 t1, T2 t2)
+  { return callLatestf (key, vf::bind (f, t1, t2)); }
+
+  template <class Fn, class T1, class T2, class T3>
+  bool callLatest (CoalescingKey& key, Fn f, T1 t1, T2 t2, T3 t3)
+  { return callLatestf (key, vf::bind (f, t1, t2, t3)); }
+
+  template <class Fn, class T1, class T2, class T3, class T4>
+  bool callLatest (CoalescingKey& key, Fn f, T1 t1, T2 t2, T3 t3, T4 t4)
+  { return callLatestf (key, vf::bind (f, t1, t2, t3, t4)); }
+
+  template <class Fn, class T1, class T2, class T3, class T4, class T5>
+  bool callLatest (CoalescingKey& key, Fn f, T1 t1, T2 t2, T3 t3, T4 t4, T5 t5)
+  { return callLatestf (key, vf::bind (f, t1, t2, t3, t4, t5)); }
+
+  template <class Fn, class T1, class T2, class T3, class T4, class T5, class T6>
+  bool callLatest (CoalescingKey& key, Fn f, T1 t1, T2 t2, T3 t3, T4 t4, T5 t5, T6 t6)
+  { return callLatestf (key, vf::bind (f, t1, t2, t3, t4, t5, t6)); }
+
+  template <class Fn, class T1, class T2, class T3, class T4, class T5, class T6, class T7>
+  bool callLatest (CoalescingKey& key, Fn f, T1 t1, T2 t2, T3 t3, T4 t4, T5 t5, T6 t6, T7 t7)
+  { return callLatestf (key, vf::bind (f, t1, t2, t3, t4, t5, t6, t7)); }
+
+  template <class Fn, class T1, class T2, class T3, class T4, class T5, class T6, class T7, class T8>
+  bool callLatest (CoalescingKey& key, Fn f, T1 t1, T2 t2, T3 t3, T4 t4, T5 t5, T6 t6, T7 t7, T8 t8)
+  { return callLatestf (key, vf::bind (f, t1, t2, t3, t4, t5, t6, t7, t8)); }
+  /** @} */
+
+  //============================================================================
+
+  template <class R>
+  class Future;
+
+  /** Add a functor whose result is returned through a Future.
+
+      This works like callf(), except that the return value of the functor
+      is stored in a shared state, which the Future refers to. A continuation
+      attached with Future::then() receives the result on the queue of your
+      choice, so a round trip to another thread needs no hand-written reply.
+
+      @code
+
+      struct Database
+      {
+        int lookup (String key);
+      };
+
+      void showCount (int count);
+
+      void example (Database* db, CallQueue& dbQueue, CallQueue& guiQueue)
+      {
+        dbQueue.callWithResultf (vf::bind (&Database::lookup, db, "tracks"))
+          .then (guiQueue, &showCount);
+      }
+
+      @endcode
+
+      If the queue has a capacity and rejects the call, the returned Future
+      is empty. Future::isValid() returns `false`, and then() does nothing,
+      so the example above quietly drops the lookup. Check isValid() when
+      the caller needs to know.
+
+      @param f The functor to add. It must define result_type, which is the
+               case for the return value of bind().
+
+      @return A Future for the result, or an empty Future if the queue was
+              full and the call was rejected.
+
+      @see callWithResult
+  */
+  template <class Functor>
+  Future <typename Functor::result_type> callWithResultf (Functor const& f)
+  {
+    return callWithResultp <typename Functor::result_type> (f);
+  }
+
+  /** Add a function call whose result is returned through a Future.
+
+      The result type must be given explicitly:
+
+      @code
+
+      CallQueue::Future <int> count = dbQueue.callWithResult <int> (
+        &Database::lookup, db, "tracks");
+
+      @endcode
+
+      @see callWithResultf
+  */
+  /** @{ */
+  template <class R, class Fn>
+  Future <R> callWithResult (Fn f)
+  { return callWithResultp <R> (vf::bind (f)); }
+
+  template <class R, class Fn, class T1>
+  Future <R> callWithResult (Fn f, T1 t1)
+  { return callWithResultp <R> (vf::bind (f, t1)); }
+
+  template <class R, class Fn, class T1, class T2>
+  Future <R> callWithResult (Fn f, T1 t1, T2 t2)
+  { return callWithResultp <R> (vf::bind (f, t1, t2)); }
+
+  template <class R, class Fn, class T1, class T2, class T3>
+  Future <R> callWithResult (Fn f, T1 t1, T2 t2, T3 t3)
+  { return callWithResultp <R> (vf::bind (f, t1, t2, t3)); }
+
+  template <class R, class Fn, class T1, class T2, class T3, class T4>
+  Future <R> callWithResult (Fn f, T1 t1, T2 t2, T3 t3, T4 t4)
+  { return callWithResultp <R> (vf::bind (f, t1, t2, t3, t4)); }
+
+  template <class R, class Fn, class T1, class T2, class T3, class T4, class T5>
+  Future <R> callWithResult (Fn f, T1 t1, T2 t2, T3 t3, T4 t4, T5 t5)
+  { return callWithResultp <R> (vf::bind (f, t1, t2, t3, t4, t5)); }
+
+  template <class R, class Fn, class T1, class T2, class T3, class T4, class T5, class T6>
+  Future <R> callWithResult (Fn f, T1 t1, T2 t2, T3 t3, T4 t4, T5 t5, T6 t6)
+  { return callWithResultp <R> (vf::bind (f, t1, t2, t3, t4, t5, t6)); }
+
+  template <class R, class Fn, class T1, class T2, class T3, class T4, class T5, class T6, class T7>
+  Future <R> callWithResult (Fn f, T1 t1, T2 t2, T3 t3, T4 t4, T5 t5, T6 t6, T7 t7)
+  { return callWithResultp <R> (vf::bind (f, t1, t2, t3, t4, t5, t6, t7)); }
+
+  template <class R, class Fn, class T1, class T2, class T3, class T4, class T5, class T6, class T7, class T8>
+  Future <R> callWithResult (Fn f, T1 t1, T2 t2, T3 t3, T4 t4, T5 t5, T6 t6, T7 t7, T8 t8)
+  { return callWithResultp <R> (vf::bind (f, t1, t2, t3, t4, t5, t6, t7, t8)); }
+  /** @} */
+
 protected:
   //============================================================================
   /** Synchronize the queue.
@@ -410,6 +737,29 @@ protected:
   */
   bool synchronize ();
 
+  /** Synchronize the queue within a budget.
+
+      This works like synchronize(), but stops calling functors once either
+      limit is reached. Functors left in the queue stay there, and the queue
+      remains signaled so they are processed by a later synchronize. This
+      lets a real-time thread spread a large backlog across several
+      callbacks instead of overrunning its deadline.
+
+      The time limit is checked after each functor returns, so a single
+      long-running functor can still exceed it, and at least one functor
+      is called even when `maxMicroseconds` is 0. When `maxCalls` is 0, no
+      functors are called.
+
+      @param maxCalls        The maximum number of functors to call, or -1
+                             for no limit.
+
+      @param maxMicroseconds The maximum time to spend calling functors, or
+                             -1 for no limit.
+
+      @return The number of functors remaining in the queue.
+  */
+  int synchronize (int maxCalls, int maxMicroseconds);
+
   /** Close the queue.
 
       Functors may not be added after this routine is called. This is used for
@@ -448,17 +798,27 @@ public:
 
       Custom implementations use this to control the allocation.
 
-      @param c The call to add. The memory must come from the allocator.
+      @param c        The call to add. The memory must come from the allocator.
+
+      @param priority The lane to add the call to.
+
+      @return `false` if the queue was full and the call was rejected. The
+              call is deleted in this case.
   */
-  void callp (Work* c);
+  bool callp (Work* c, Priority priority = priorityNormal);
 
   /** Queue a raw call.
   
       Custom implementations use this to control the allocation.
 
-      @param c The call to add. The memory must come from the allocator.
+      @param c        The call to add. The memory must come from the allocator.
+
+      @param priority The lane to add the call to.
+
+      @return `false` if the queue was full and the call was rejected. The
+              call is deleted in this case.
   */
-  void queuep (Work* c);
+  bool queuep (Work* c, Priority priority = priorityNormal);
 
   /** Retrieve the allocator.
 
@@ -487,6 +847,123 @@ public:
   */
   bool isBeingSynchronized () const { return m_isBeingSynchronized.isSignaled(); }
 
+  /** Limit the number of functors in the queue.
+
+      By default a queue is unbounded, so a consumer which falls behind lets
+      the queue grow until the allocator runs out of memory. A bounded queue
+      applies the chosen policy instead when the number of pending functors
+      reaches the capacity:
+
+      - overflowBlock makes the producer wait. A call made from the thread
+        associated with the queue never waits, since that would deadlock.
+
+      - overflowFail rejects the functor. The call returns `false`.
+
+      - overflowDropOldest accepts the functor, and makes room by deleting
+        the oldest pending functor without calling it. The lowest priority
+        lane is looked at first, and functors which cannot be discarded
+        are skipped. If there is nothing to discard, or the queue is being
+        synchronized at that moment, the functor is rejected as with
+        overflowFail. A call from the thread associated with the queue is
+        always accepted. Instead, when the queue is synchronized, functors
+        which have more than `capacity` newer functors behind them are
+        deleted without being called. Newer functors are counted across
+        all lanes, not per lane.
+
+      This should be called before functors are added to the queue.
+
+      @param capacity The maximum number of pending functors, or 0 for no
+                      limit.
+
+      @param policy   What to do when the queue is full.
+  */
+  void setCapacity (int capacity, OverflowPolicy policy);
+
+  /** Determine the number of times a producer waited for a full queue.
+  */
+  int getNumberOfBlockedCalls () const { return m_numberOfBlockedCalls.get (); }
+
+  /** Determine the number of functors rejected by a full queue.
+  */
+  int getNumberOfFailedCalls () const { return m_numberOfFailedCalls.get (); }
+
+  /** Determine the number of functors discarded by a full queue.
+  */
+  int getNumberOfDroppedCalls () const { return m_numberOfDroppedCalls.get (); }
+
+#if VF_USE_CALLQUEUE_STATISTICS
+  /** A histogram of durations.
+
+      Bucket 0 counts durations under one microsecond. Bucket i counts
+      durations of at least 2^(i-1) and under 2^i microseconds, and the last
+      bucket also counts everything longer. The counts can be read from any
+      thread while the queue is in use.
+  */
+  class Histogram : Uncopyable
+  {
+  public:
+    enum
+    {
+      numberOfBuckets = 24
+    };
+
+    Histogram ();
+
+    /** Count a duration. */
+    void add (int64 microseconds);
+
+    /** Retrieve the count for a bucket. */
+    int getCount (int bucket) const;
+
+    /** Retrieve the exclusive upper bound of a bucket in microseconds. */
+    static int64 getBucketLimit (int bucket);
+
+  private:
+    Atomic <int> m_counts [numberOfBuckets];
+  };
+
+  /** Statistics for a CallQueue.
+
+      These are only available when VF_USE_CALLQUEUE_STATISTICS is set.
+  */
+  class Statistics : Uncopyable
+  {
+  public:
+    /** Time from queueing a functor until it is called. */
+    Histogram const& getLatency () const { return m_latency; }
+
+    /** Time spent calling each functor. */
+    Histogram const& getExecutionTime () const { return m_executionTime; }
+
+    /** The largest number of pending functors seen so far. */
+    int getMaximumDepth () const { return m_maximumDepth.get (); }
+
+  private:
+    friend class CallQueue;
+
+    void updateMaximumDepth (int depth);
+
+    Histogram m_latency;
+    Histogram m_executionTime;
+    Atomic <int> m_maximumDepth;
+  };
+
+  /** Retrieve the statistics for this queue.
+
+      The statistics may be read from any thread without locking.
+  */
+  Statistics const& getStatistics () const { return m_statistics; }
+#endif
+
+  /** Determine the number of functors in the queue.
+
+      Since producers can add functors at any time, the value is only
+      approximate.
+
+      @return The number of functors waiting to be called.
+  */
+  int getNumberOfPendingCalls () const { return m_numberOfPendingCalls.get (); }
+
 private:
   template <class Functor>
   class CallType : public Work
@@ -499,15 +976,389 @@ private:
     Functor m_f;
   };
 
-  bool doSynchronize ();
+  template <class Functor>
+  class CancellableCallType : public Work
+  {
+  public:
+    CancellableCallType (CancellationToken const& token, Functor const& f)
+      : m_token (token)
+      , m_f (f)
+    {
+    }
+
+    void operator() ()
+    {
+      if (! m_token.isCancelled ())
+        m_f ();
+    }
+
+  private:
+    CancellationToken const& m_token;
+    Functor m_f;
+  };
+
+  // Calls the newest functor for a key.
+  //
+  class LatestCall : public Work
+  {
+  public:
+    explicit LatestCall (CoalescingKey& key) : m_key (key) { }
+    void operator() ();
+    bool canDiscard () const { return false; }
+
+  private:
+    CoalescingKey& m_key;
+  };
+
+  template <class R, class Functor>
+  Future <R> callWithResultp (Functor const& f)
+  {
+    Future <R> future (new (m_allocator) typename Future <R>::State);
+
+    if (! callp (new (m_allocator) ResultCallType <Functor, R> (f, future.m_state)))
+      return Future <R> ();
+
+    return future;
+  }
+
+  // Holds the result of a call made with callWithResultf().
+  //
+  template <class R>
+  struct FutureResult
+  {
+    typedef R const& reference;
+
+    template <class Functor>
+    void evaluate (Functor& f) { m_value = f (); }
+
+    template <class Functor>
+    void pass (Functor& f) const { f (m_value); }
+
+    reference get () const { return m_value; }
+
+    R m_value;
+  };
+
+  template <class Functor, class R>
+  class ResultCallType : public Work
+  {
+  public:
+    typedef typename Future <R>::State State;
+
+    ResultCallType (Functor const& f, State* state)
+      : m_f (f)
+      , m_state (state)
+    {
+      m_state->addReference ();
+    }
+
+    ~ResultCallType ()
+    {
+      m_state->release ();
+    }
+
+    void operator() () { m_state->setResult (m_f); }
+    bool canDiscard () const { return false; }
+
+  private:
+    Functor m_f;
+    State* const m_state;
+  };
+
+  bool doSynchronize (int maxCalls = -1, int maxMicroseconds = -1);
+  Work* popFront ();
+  Work* popFront (int priority);
+  bool discardOldest ();
+  bool reserve ();
+#if VF_USE_CALLQUEUE_STATISTICS
+  static int64 ticksToMicroseconds (int64 ticks);
+#endif
+  bool empty () const;
 
 private:
   String const m_name;
   Thread::ThreadID m_id;
-  LockFreeQueue <Work> m_queue;
+  LockFreeQueue <Work> m_queues [numberOfPriorities];
+  LockFreeQueue <Work>::Chain m_backlog [numberOfPriorities];
+  Atomic <int> m_numberOfPendingCalls;
+  int m_capacity;
+  OverflowPolicy m_overflowPolicy;
+  Atomic <int> m_numberOfWaitingProducers;
+  WaitableEvent m_spaceAvailable;
+  Atomic <int> m_numberOfBlockedCalls;
+  Atomic <int> m_numberOfFailedCalls;
+  Atomic <int> m_numberOfDroppedCalls;
+#if VF_USE_CALLQUEUE_STATISTICS
+  Statistics m_statistics;
+#endif
   AtomicFlag m_closed;
   AtomicFlag m_isBeingSynchronized;
   AllocatorType m_allocator;
 };
 
+template <>
+struct CallQueue::FutureResult <void>
+{
+  typedef void reference;
+
+  template <class Functor>
+  void evaluate (Functor& f) { f (); }
+
+  template <class Functor>
+  void pass (Functor& f) const { f (); }
+
+  void get () const { }
+};
+
+//==============================================================================
+/**
+  The eventual result of a call made with CallQueue::callWithResultf().
+
+  A Future is a lightweight, reference counted handle to a shared state,
+  which is allocated from the CallQueue allocator. The state holds the
+  result once the call has run, along with at most one continuation.
+
+  The result type must be default constructible and assignable, or void.
+
+  @ingroup vf_concurrent
+*/
+template <class R>
+class CallQueue::Future
+{
+public:
+  typedef R result_type;
+
+  /** Create an empty Future, which is not associated with any call.
+  */
+  Future () : m_state (nullptr)
+  {
+  }
+
+  Future (Future const& other) : m_state (other.m_state)
+  {
+    if (m_state != nullptr)
+      m_state->addReference ();
+  }
+
+  Future& operator= (Future const& other)
+  {
+    if (other.m_state != nullptr)
+      other.m_state->addReference ();
+
+    if (m_state != nullptr)
+      m_state->release ();
+
+    m_state = other.m_state;
+
+    return *this;
+  }
+
+  ~Future ()
+  {
+    if (m_state != nullptr)
+      m_state->release ();
+  }
+
+  /** Determine if the Future refers to a call.
+
+      A Future is empty when it was default constructed, or when the queue
+      rejected the call because it was full.
+
+      @return `true` if the Future refers to a call.
+  */
+  bool isValid () const
+  {
+    return m_state != nullptr;
+  }
+
+  /** Determine if the call has finished.
+
+      @return `true` if the result is available.
+  */
+  bool isReady () const
+  {
+    return m_state != nullptr && m_state->isReady ();
+  }
+
+  /** Retrieve the result.
+
+      The caller must first make sure that the result is ready. This
+      function does not wait.
+  */
+  typename FutureResult <R>::reference getResult () const
+  {
+    jassert (isReady ());
+
+    return m_state->getResult ();
+  }
+
+  /** Attach a continuation.
+
+      The continuation is called with the result, as `f (result)`, or with
+      no arguments when the result type is void. It always goes through the
+      specified queue, even if the result is already available when this is
+      called. Only one continuation may be attached to a Future.
+
+      The continuation is queued with the overflow policy of the specified
+      queue. If that queue has a capacity and rejects the call, the
+      continuation is deleted without being called, and nobody is told.
+      Debug builds assert. Use a queue without a capacity, or one which
+      blocks, for continuations that must run.
+
+      To pass extra arguments to a member function, bind them with the
+      placeholder:
+
+      @code
+
+      future.then (guiQueue, vf::bind (&Display::setCount, display, vf::_1));
+
+      @endcode
+
+      Calling this on an empty Future does nothing.
+
+      @param queue The queue on which to call the continuation.
+
+      @param f     The continuation.
+
+      @see isValid
+  */
+  template <class Functor>
+  void then (CallQueue& queue, Functor const& f)
+  {
+    if (m_state != nullptr)
+    {
+      m_state->setContinuation (queue,
+        new (queue.getAllocator ()) ContinuationType <Functor> (f, m_state));
+    }
+  }
+
+private:
+  friend class CallQueue;
+
+  class State : public AllocatedBy <AllocatorType>, Uncopyable
+  {
+  public:
+    State ()
+      : m_references (1)
+      , m_continuation (nullptr)
+      , m_continuationQueue (nullptr)
+    {
+    }
+
+    void addReference ()
+    {
+      ++m_references;
+    }
+
+    void release ()
+    {
+      if (--m_references == 0)
+        delete this;
+    }
+
+    bool isReady () const
+    {
+      return m_status.get () == statusReady;
+    }
+
+    typename FutureResult <R>::reference getResult () const
+    {
+      return m_result.get ();
+    }
+
+    template <class Functor>
+    void setResult (Functor& f)
+    {
+      m_result.evaluate (f);
+
+      // Publish the result. If a continuation was already attached,
+      // it is now our job to queue it.
+      //
+      if (m_status.exchange (statusReady) == statusContinuation)
+      {
+        // A full queue deletes the continuation.
+#if VF_DEBUG
+        const bool accepted = m_continuationQueue->callp (m_continuation);
+        jassert (accepted);
+#else
+        m_continuationQueue->callp (m_continuation);
+#endif
+      }
+    }
+
+    void setContinuation (CallQueue& queue, Work* work)
+    {
+      jassert (m_continuation == nullptr);
+
+      m_continuation = work;
+      m_continuationQueue = &queue;
+
+      // If the result is already published, queue the continuation
+      // ourselves. Otherwise, setResult() will do it.
+      //
+      if (! m_status.compareAndSetBool (statusContinuation, statusPending))
+      {
+        // A full queue deletes the continuation.
+#if VF_DEBUG
+        const bool accepted = queue.callp (work);
+        jassert (accepted);
+#else
+        queue.callp (work);
+#endif
+      }
+    }
+
+    template <class Functor>
+    void passResult (Functor& f) const
+    {
+      m_result.pass (f);
+    }
+
+  private:
+    enum
+    {
+      statusPending,
+      statusContinuation,
+      statusReady
+    };
+
+    Atomic <int> m_references;
+    Atomic <int> m_status;
+    Work* m_continuation;
+    CallQueue* m_continuationQueue;
+    FutureResult <R> m_result;
+  };
+
+  template <class Functor>
+  class ContinuationType : public Work
+  {
+  public:
+    ContinuationType (Functor const& f, State* state)
+      : m_f (f)
+      , m_state (state)
+    {
+      m_state->addReference ();
+    }
+
+    ~ContinuationType ()
+    {
+      m_state->release ();
+    }
+
+    void operator() () { m_state->passResult (m_f); }
+    bool canDiscard () const { return false; }
+
+  private:
+    Functor m_f;
+    State* const m_state;
+  };
+
+  explicit Future (State* state) : m_state (state)
+  {
+  }
+
+private:
+  State* m_state;
+};
+
 #endif
@@ -0,0 +1,111 @@
+/*============================================================================*/
+/*
+  VFLib: https://github.com/vinniefalco/VFLib
+
+  Copyright (C) 2008 by Vinnie Falco <vinnie.falco@gmail.com>
+
+  This library contains portions of other open source products covered by
+  separate licenses. Please see the corresponding source files for specific
+  terms.
+  
+  VFLib is provided under the terms of The MIT License (MIT):
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+  IN THE SOFTWARE.
+*/
+/*============================================================================*/
+
+#ifndef VF_CANCELLATIONTOKEN_VFHEADER
+#define VF_CANCELLATIONTOKEN_VFHEADER
+
+/*============================================================================*/
+/**
+  Requests that queued work be skipped.
+
+  A token is attached to work when it is queued, with CallQueue::callf(),
+  CallQueue::queuef(), ThreadGroup::callf() or
+  ParallelFor::setCancellationToken(). After cancel() is called, work which
+  has not started yet is discarded when it comes out of the queue, instead
+  of being called. Work which is already running can call isCancelled() to
+  stop early:
+
+  @code
+
+  CancellationToken token;
+
+  void renderThumbnails (Thumbnails* thumbnails)
+  {
+    for (int i = 0; i < thumbnails->size (); ++i)
+    {
+      if (token.isCancelled ())
+        break;
+
+      thumbnails->render (i);
+    }
+  }
+
+  void scrolledAway ()
+  {
+    token.cancel ();
+  }
+
+  @endcode
+
+  A token is just one atomic integer, and attaching it does not allocate. The
+  owner must keep the token alive until all the work it is attached to has
+  come out of its queue.
+
+  @ingroup vf_concurrent
+*/
+class CancellationToken : Uncopyable
+{
+public:
+  CancellationToken () { }
+
+  /** Request cancellation.
+
+      This can be called from any thread.
+  */
+  void cancel ()
+  {
+    m_cancelled.set (1);
+  }
+
+  /** Clear the cancellation so the token can be reused.
+
+      Work which is still queued with the token will run again.
+  */
+  void reset ()
+  {
+    m_cancelled.set (0);
+  }
+
+  /** Determine if cancellation was requested.
+
+      @return `true` if cancel() was called.
+  */
+  bool isCancelled () const
+  {
+    return m_cancelled.get () != 0;
+  }
+
+private:
+  Atomic <int> m_cancelled;
+};
+
+#endif
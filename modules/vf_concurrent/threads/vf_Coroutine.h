@@ -0,0 +1,231 @@
+/*============================================================================*/
+/*
+  VFLib: https://github.com/vinniefalco/VFLib
+
+  Copyright (C) 2008 by Vinnie Falco <vinnie.falco@gmail.com>
+
+  This library contains portions of other open source products covered by
+  separate licenses. Please see the corresponding source files for specific
+  terms.
+  
+  VFLib is provided under the terms of The MIT License (MIT):
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+  IN THE SOFTWARE.
+*/
+/*============================================================================*/
+
+#ifndef VF_COROUTINE_VFHEADER
+#define VF_COROUTINE_VFHEADER
+
+/*============================================================================*/
+/**
+  @ingroup vf_concurrent
+
+  @brief A coroutine which moves between threads by awaiting queues.
+
+  With a compiler that supports C++20 coroutines, a function returning
+  Coroutine can use `co_await switchTo (...)` to continue on the thread of a
+  CallQueue or ThreadGroup. A pipeline of several hops then reads as one
+  function, instead of a chain of bound callbacks:
+
+  @code
+
+  Coroutine loadTrack (File file, ThreadWithCallQueue& io, GuiCallQueue& gui)
+  {
+    co_await switchTo (io);
+
+    MemoryBlock data = readFile (file);         // on the io thread
+
+    co_await switchTo (*GlobalThreadGroup::getInstance ());
+
+    Analysis analysis = analyze (data);         // on a ThreadGroup thread
+
+    co_await switchTo (gui);
+
+    showAnalysis (analysis);                    // in the GuiCallQueue
+  }
+
+  @endcode
+
+  Local variables live in the coroutine frame, which is allocated from a
+  FifoFreeStoreType, so the frame must be smaller than a page of the
+  allocator. Each hop queues one small Work holding only the coroutine
+  handle.
+
+  The coroutine starts running immediately on the calling thread, and its
+  frame is destroyed when it finishes.
+
+  If a CallQueue with a capacity rejects the hop, `co_await switchTo (...)`
+  continues on the current thread and throws an Error. Nobody receives an
+  exception which escapes the coroutine, and the thread that resumed it is
+  in the middle of an unrelated synchronize(), so an escaping exception
+  calls std::terminate(). Catch exceptions inside the coroutine.
+
+  This is only available when VF_USE_COROUTINES is set, which happens
+  automatically when the compiler supports coroutines.
+*/
+class Coroutine
+{
+public:
+  class promise_type
+  {
+  public:
+    typedef GlobalFifoFreeStore <Coroutine> AllocatorType;
+
+    Coroutine get_return_object () { return Coroutine (); }
+
+    std::suspend_never initial_suspend () noexcept { return std::suspend_never (); }
+
+    std::suspend_never final_suspend () noexcept { return std::suspend_never (); }
+
+    void return_void () { }
+
+    void unhandled_exception () noexcept { std::terminate (); }
+
+    static void* operator new (size_t bytes)
+    {
+      return AllocatorType::getInstance ()->allocate (bytes);
+    }
+
+    static void operator delete (void* p)
+    {
+      AllocatorType::deallocate (p);
+    }
+  };
+};
+
+//------------------------------------------------------------------------------
+
+/** Resumes a suspended coroutine.
+
+    @internal
+*/
+class CoroutineResumer
+{
+public:
+  explicit CoroutineResumer (std::coroutine_handle <> handle) : m_handle (handle) { }
+
+  void operator() () const { m_handle.resume (); }
+
+private:
+  std::coroutine_handle <> m_handle;
+};
+
+/** Awaitable which continues a coroutine in a CallQueue.
+
+    @see switchTo
+*/
+class CallQueueAwaiter
+{
+public:
+  CallQueueAwaiter (CallQueue& queue, CallQueue::Priority priority)
+    : m_queue (queue)
+    , m_priority (priority)
+    , m_rejected (false)
+  {
+  }
+
+  bool await_ready () const noexcept { return false; }
+
+  bool await_suspend (std::coroutine_handle <> handle)
+  {
+    // This may resume the coroutine right away if we are on the queue's
+    // thread, so nothing may be touched after the call unless it failed.
+    //
+    if (m_queue.callp (new (m_queue.getAllocator ()) Resume (handle), m_priority))
+      return true;
+
+    // Not queued, so the coroutine continues here.
+    m_rejected = true;
+
+    return false;
+  }
+
+  void await_resume () const
+  {
+    if (m_rejected)
+      Throw (Error().fail (__FILE__, __LINE__, TRANS("the queue rejected the coroutine")));
+  }
+
+private:
+  // The frame leaks if this is not called, so it may not be discarded.
+  //
+  class Resume : public CallQueue::Work
+  {
+  public:
+    explicit Resume (std::coroutine_handle <> handle) : m_handle (handle) { }
+    void operator() () { m_handle.resume (); }
+    bool canDiscard () const { return false; }
+
+  private:
+    std::coroutine_handle <> m_handle;
+  };
+
+  CallQueue& m_queue;
+  CallQueue::Priority const m_priority;
+  bool m_rejected;
+};
+
+/** Awaitable which continues a coroutine on a ThreadGroup.
+
+    @see switchTo
+*/
+class ThreadGroupAwaiter
+{
+public:
+  explicit ThreadGroupAwaiter (ThreadGroup& group) : m_group (group) { }
+
+  bool await_ready () const noexcept { return false; }
+
+  void await_suspend (std::coroutine_handle <> handle)
+  {
+    m_group.callf (1, CoroutineResumer (handle));
+  }
+
+  void await_resume () const noexcept { }
+
+private:
+  ThreadGroup& m_group;
+};
+
+/** Continue a coroutine elsewhere.
+
+    When used with `co_await`, the coroutine is suspended and then resumed
+    inside the synchronize() of the queue, or on a thread of the group.
+
+    @param queue    The queue to continue in.
+
+    @param priority The lane to use in the queue.
+
+    @see Coroutine
+*/
+/** @{ */
+inline CallQueueAwaiter switchTo (CallQueue& queue,
+                                  CallQueue::Priority priority = CallQueue::priorityNormal)
+{
+  return CallQueueAwaiter (queue, priority);
+}
+
+inline ThreadGroupAwaiter switchTo (ThreadGroup& group)
+{
+  return ThreadGroupAwaiter (group);
+}
+/** @} */
+
+#endif
@@ -0,0 +1,132 @@
+/*============================================================================*/
+/*
+  VFLib: https://github.com/vinniefalco/VFLib
+
+  Copyright (C) 2008 by Vinnie Falco <vinnie.falco@gmail.com>
+
+  This library contains portions of other open source products covered by
+  separate licenses. Please see the corresponding source files for specific
+  terms.
+  
+  VFLib is provided under the terms of The MIT License (MIT):
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+  IN THE SOFTWARE.
+*/
+/*============================================================================*/
+
+DistributedReadWriteMutex::DistributedReadWriteMutex ()
+{
+  // Twice as many slots as CPUs keeps collisions
+  // between the hashed thread IDs infrequent.
+  //
+  int numberOfSlots = 1;
+  while (numberOfSlots < 2 * SystemStats::getNumCpus ())
+    numberOfSlots *= 2;
+
+  m_slotMask = numberOfSlots - 1;
+  m_slots = new Slot [numberOfSlots];
+}
+
+DistributedReadWriteMutex::~DistributedReadWriteMutex ()
+{
+  delete [] m_slots;
+}
+
+// The same thread always maps to the same slot, so exitRead()
+// finds the counter that enterRead() incremented even if the
+// thread has since migrated to another core.
+//
+DistributedReadWriteMutex::Slot& DistributedReadWriteMutex::getSlot () const noexcept
+{
+  uint64 const id = uint64 (pointer_sized_int (Thread::getCurrentThreadId ()));
+
+  // Fibonacci hashing spreads out the aligned thread IDs.
+  int const index = int ((id * 0x9E3779B97F4A7C15ULL) >> 32) & m_slotMask;
+
+  return m_slots [index];
+}
+
+void DistributedReadWriteMutex::enterRead () const noexcept
+{
+  Slot& slot = getSlot ();
+
+  for (;;)
+  {
+    // attempt the lock optimistically
+    slot->addref ();
+
+    // is there a writer?
+    if (m_writes->isSignaled ())
+    {
+      // a writer exists, give up the read lock
+      slot->release ();
+
+      // block until the writer is done
+      {
+        CriticalSection::ScopedLockType lock (m_mutex);
+      }
+
+      // now try the loop again
+    }
+    else
+    {
+      break;
+    }
+  }
+}
+
+void DistributedReadWriteMutex::exitRead () const noexcept
+{
+  getSlot ()->release ();
+}
+
+void DistributedReadWriteMutex::enterWrite () const noexcept
+{
+  // Optimistically acquire the write lock.
+  m_writes->addref ();
+
+  // Go for the mutex.
+  // Another writer might block us here.
+  m_mutex.enter ();
+
+  // Drain the readers in every slot. New readers
+  // will see the writer count and block on the mutex.
+  //
+  for (int i = 0; i <= m_slotMask; ++i)
+  {
+    if (m_slots [i]->isSignaled ())
+    {
+      SpinDelay delay;
+      do
+      {
+        delay.pause ();
+      }
+      while (m_slots [i]->isSignaled ());
+    }
+  }
+}
+
+void DistributedReadWriteMutex::exitWrite () const noexcept
+{
+  // Same ordering as ReadWriteMutex, to keep writes preferenced.
+
+  m_mutex.exit ();
+
+  m_writes->release ();
+}
@@ -0,0 +1,112 @@
+/*============================================================================*/
+/*
+  VFLib: https://github.com/vinniefalco/VFLib
+
+  Copyright (C) 2008 by Vinnie Falco <vinnie.falco@gmail.com>
+
+  This library contains portions of other open source products covered by
+  separate licenses. Please see the corresponding source files for specific
+  terms.
+  
+  VFLib is provided under the terms of The MIT License (MIT):
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+  IN THE SOFTWARE.
+*/
+/*============================================================================*/
+
+#ifndef VF_DISTRIBUTEDREADWRITEMUTEX_VFHEADER
+#define VF_DISTRIBUTEDREADWRITEMUTEX_VFHEADER
+
+/*============================================================================*/
+/**
+  A ReadWriteMutex with per-thread reader counters.
+
+  ReadWriteMutex counts readers in a single shared counter, so every reader
+  on every core writes to the same cache line. This "big reader" variant
+  spreads the count over one counter per slot, each on its own cache line,
+  and picks the slot from a hash of the calling thread's ID. Readers on
+  different cores then rarely touch the same line, at the cost of writers
+  having to scan every slot.
+
+  This is the better choice when reads vastly outnumber writes and many
+  threads read at once. It follows the same rules as ReadWriteMutex, and the
+  scoped lock types are interchangeable. Each instance allocates a cache
+  line per slot, so prefer ReadWriteMutex for locks which are numerous or
+  rarely contended.
+
+  @see ReadWriteMutex
+
+  @ingroup vf_concurrent
+*/
+class DistributedReadWriteMutex : Uncopyable
+{
+public:
+  /** Provides the type of scoped read lock to use with this mutex. */
+  typedef GenericScopedReadLock <DistributedReadWriteMutex> ScopedReadLockType;
+
+  /** Provides the type of scoped write lock to use with this mutex. */
+  typedef GenericScopedWriteLock <DistributedReadWriteMutex> ScopedWriteLockType;
+
+  /** Create a DistributedReadWriteMutex.
+
+      The number of slots is chosen from the number of CPUs.
+  */
+  DistributedReadWriteMutex ();
+
+  /** Destroy a DistributedReadWriteMutex.
+
+      If the object is destroyed while a lock is held, the result is
+      undefined behavior.
+  */
+  ~DistributedReadWriteMutex ();
+
+  /** Acquire a read lock.
+
+      This is recursive with respect to other read locks. Calling this while
+      holding a write lock is undefined.
+  */
+  void enterRead () const noexcept;
+
+  /** Release a previously acquired read lock */
+  void exitRead () const noexcept;
+
+  /** Acquire a write lock.
+
+      This is recursive with respect to other write locks. Calling this while
+      holding a read lock is undefined.
+  */
+  void enterWrite () const noexcept;
+
+  /** Release a previously acquired write lock */
+  void exitWrite () const noexcept;
+
+private:
+  typedef CacheLine::Aligned <AtomicCounter> Slot;
+
+  Slot& getSlot () const noexcept;
+
+private:
+  CriticalSection m_mutex;
+
+  mutable CacheLine::Padded <AtomicCounter> m_writes;
+  int m_slotMask;
+  Slot* m_slots;
+};
+
+#endif
@@ -45,6 +45,11 @@ bool ManualCallQueue::synchronize ()
   return CallQueue::synchronize ();
 }
 
+int ManualCallQueue::synchronize (int maxCalls, int maxMicroseconds)
+{
+  return CallQueue::synchronize (maxCalls, maxMicroseconds);
+}
+
 void ManualCallQueue::signal ()
 {
 }
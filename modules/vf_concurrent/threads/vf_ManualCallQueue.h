@@ -100,6 +100,21 @@ public:
   */
   bool synchronize ();
 
+  /** Synchronize the queue within a budget.
+
+      This is intended for real-time threads, for example an audio callback
+      which must not overrun its deadline when there is a backlog.
+
+      @param maxCalls        The maximum number of functors to call, or -1
+                             for no limit.
+
+      @param maxMicroseconds The maximum time to spend calling functors, or
+                             -1 for no limit.
+
+      @return The number of functors remaining in the queue.
+  */
+  int synchronize (int maxCalls, int maxMicroseconds);
+
 private:
   void signal ();
   void reset ();
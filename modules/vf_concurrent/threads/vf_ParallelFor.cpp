@@ -32,6 +32,8 @@
 
 ParallelFor::ParallelFor (ThreadGroup& pool)
   : m_pool (pool)
+  , m_schedule (Schedule::dynamic ())
+  , m_cancellationToken (nullptr)
   , m_finishedEvent (false) // auto-reset
 {
 }
@@ -41,7 +43,30 @@ int ParallelFor::getNumberOfThreads () const
   return m_pool.getNumberOfThreads ();
 }
 
+void ParallelFor::setSchedule (Schedule const& schedule)
+{
+  m_schedule = schedule;
+}
+
+void ParallelFor::setCancellationToken (CancellationToken const* token)
+{
+  m_cancellationToken = token;
+}
+
+int ParallelFor::getNumberOfBlocks (int numberOfIterations) const
+{
+  return std::min (numberOfIterations,
+                   blocksPerThread * (getNumberOfThreads () + 1));
+}
+
 void ParallelFor::doLoop (int numberOfIterations, Iteration& iteration)
+{
+  doLoop (numberOfIterations, iteration, m_schedule);
+}
+
+void ParallelFor::doLoop (int numberOfIterations,
+                          Iteration& iteration,
+                          Schedule const& schedule)
 {
   if (numberOfIterations > 1)
   {
@@ -59,7 +84,8 @@ void ParallelFor::doLoop (int numberOfIterations, Iteration& iteration)
       numberOfThreads + 1, numberOfIterations);
 
     LoopState* loopState (new (m_pool.getAllocator ()) LoopState (
-      iteration, m_finishedEvent, numberOfIterations, numberOfParallelInstances));
+      iteration, m_finishedEvent, schedule, m_cancellationToken,
+      numberOfIterations, numberOfParallelInstances));
 
     m_pool.call (maxThreads, &LoopState::forLoopBody, loopState);
 
@@ -71,6 +97,7 @@ void ParallelFor::doLoop (int numberOfIterations, Iteration& iteration)
   else if (numberOfIterations == 1)
   {
     // Just one iteration, so do it.
-    iteration (0);
+    if (m_cancellationToken == nullptr || ! m_cancellationToken->isCancelled ())
+      iteration (0, 1);
   }
 }
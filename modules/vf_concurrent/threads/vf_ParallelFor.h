@@ -61,6 +61,30 @@
 
   @note The last argument to function () is always the loop index.
 
+  When each iteration does very little work, handing out one index at a
+  time costs more than the work itself. A Schedule controls how the indices
+  are divided among the threads, and loopRange() passes a whole sub-range to
+  the functor so that its inner loop can be optimized by the compiler:
+
+  @code
+
+  void scale (float* samples, float gain, int begin, int end)
+  {
+    for (int i = begin; i < end; ++i)
+      samples [i] *= gain;
+  }
+
+  ParallelFor pf;
+
+  pf.setSchedule (ParallelFor::Schedule::guided (1024));
+
+  pf.loopRange (numberOfSamples, &scale, samples, 0.5f);
+
+  @endcode
+
+  @note The last two arguments to function () passed to loopRange() are
+        always the beginning and one past the end of the sub-range.
+
   @see ThreadGroup
 
   @ingroup vf_concurrent
@@ -68,6 +92,65 @@
 class ParallelFor : Uncopyable
 {
 public:
+  /** Determines how loop indices are divided among threads.
+  */
+  class Schedule
+  {
+  public:
+    /** Threads claim chunks of grainSize indices as they become free.
+
+        This balances uneven iterations well. A grain size of one gives the
+        finest balancing at the highest cost per index.
+    */
+    static Schedule dynamic (int grainSize = 1)
+    {
+      return Schedule (typeDynamic, grainSize);
+    }
+
+    /** Indices are divided among the threads up front.
+
+        Each thread takes every n-th chunk of chunkSize indices, without any
+        further synchronization. If chunkSize is zero, each thread gets one
+        contiguous block of about the same size. This is the cheapest choice
+        when every iteration costs the same.
+    */
+    static Schedule staticChunks (int chunkSize = 0)
+    {
+      return Schedule (typeStatic, chunkSize);
+    }
+
+    /** Threads claim chunks that shrink as the loop progresses.
+
+        Each chunk is a fraction of the remaining indices, but never smaller
+        than grainSize. Early chunks are large to keep the number of claims
+        low, and the small chunks at the end balance the load.
+    */
+    static Schedule guided (int grainSize = 1)
+    {
+      return Schedule (typeGuided, grainSize);
+    }
+
+  private:
+    friend class ParallelFor;
+
+    enum Type
+    {
+      typeDynamic,
+      typeStatic,
+      typeGuided
+    };
+
+    Schedule (Type type, int chunkSize)
+      : m_type (type)
+      , m_chunkSize (chunkSize)
+    {
+      jassert (chunkSize > 0 || (type == typeStatic && chunkSize == 0));
+    }
+
+    Type m_type;
+    int m_chunkSize;
+  };
+
   /** Create a parallel for loop.
 
       It is best to keep this object around instead of creating and destroying
@@ -84,6 +167,26 @@ public:
   */
   int getNumberOfThreads () const;
 
+  /** Change the schedule used for subsequent loops.
+
+      The default is Schedule::dynamic (1).
+
+      @param schedule The new schedule.
+  */
+  void setSchedule (Schedule const& schedule);
+
+  /** Attach a cancellation token to subsequent loops.
+
+      Once the token is cancelled, ranges of indices which have not started
+      are skipped, and the loop returns as soon as the ranges in progress
+      finish. A long loop body can poll the token to stop sooner. The result
+      of reduce() or a scan is meaningless if the loop was cancelled.
+
+      @param token The token, or nullptr for loops which always run to
+                   completion. The token must outlive the loops.
+  */
+  void setCancellationToken (CancellationToken const* token);
+
   template <class F, class T1>
   void operator() (int numberOfIterations, T1 t1)
   {
@@ -144,12 +247,189 @@ public:
   { loopf (n, vf::bind (f, t1, t2, t3, t4, t5, t6, t7, t8, vf::_1)); }
   /** @} */
 
+  /** Execute parallel for loop over sub-ranges.
+
+      The range [0, numberOfIterations) is divided into sub-ranges according
+      to the schedule. Functor is called once for each sub-range with the
+      first index and one past the last index, using the ThreadGroup.
+
+      @param numberOfIterations The number of times to loop.
+
+      @param f The functor to call for each sub-range.
+  */
+  /** @{ */
+  template <class Functor>
+  void loopRangef (int numberOfIterations, Functor const& f)
+  {
+    RangeIterationType <Functor> iteration (f);
+
+    doLoop (numberOfIterations, iteration);
+  }
+
+  template <class Fn>
+  void loopRange (int n, Fn f)
+  { loopRangef (n, vf::bind (f, vf::_1, vf::_2)); }
+
+  template <class Fn, class T1>
+  void loopRange (int n, Fn f, T1 t1)
+  { loopRangef (n, vf::bind (f, t1, vf::_1, vf::_2)); }
+
+  template <class Fn, class T1, class T2>
+  void loopRange (int n, Fn f, T1 t1, T2 t2)
+  { loopRangef (n, vf::bind (f, t1, t2, vf::_1, vf::_2)); }
+
+  template <class Fn, class T1, class T2, class T3>
+  void loopRange (int n, Fn f, T1 t1, T2 t2, T3 t3)
+  { loopRangef (n, vf::bind (f, t1, t2, t3, vf::_1, vf::_2)); }
+
+  template <class Fn, class T1, class T2, class T3, class T4>
+  void loopRange (int n, Fn f, T1 t1, T2 t2, T3 t3, T4 t4)
+  { loopRangef (n, vf::bind (f, t1, t2, t3, t4, vf::_1, vf::_2)); }
+
+  template <class Fn, class T1, class T2, class T3, class T4, class T5>
+  void loopRange (int n, Fn f, T1 t1, T2 t2, T3 t3, T4 t4, T5 t5)
+  { loopRangef (n, vf::bind (f, t1, t2, t3, t4, t5, vf::_1, vf::_2)); }
+
+  template <class Fn, class T1, class T2, class T3, class T4, class T5, class T6>
+  void loopRange (int n, Fn f, T1 t1, T2 t2, T3 t3, T4 t4, T5 t5, T6 t6)
+  { loopRangef (n, vf::bind (f, t1, t2, t3, t4, t5, t6, vf::_1, vf::_2)); }
+
+  template <class Fn, class T1, class T2, class T3, class T4, class T5, class T6, class T7>
+  void loopRange (int n, Fn f, T1 t1, T2 t2, T3 t3, T4 t4, T5 t5, T6 t6, T7 t7)
+  { loopRangef (n, vf::bind (f, t1, t2, t3, t4, t5, t6, t7, vf::_1, vf::_2)); }
+
+  template <class Fn, class T1, class T2, class T3, class T4, class T5, class T6, class T7, class T8>
+  void loopRange (int n, Fn f, T1 t1, T2 t2, T3 t3, T4 t4, T5 t5, T6 t6, T7 t7, T8 t8)
+  { loopRangef (n, vf::bind (f, t1, t2, t3, t4, t5, t6, t7, t8, vf::_1, vf::_2)); }
+  /** @} */
+
+  /** Compute a reduction in parallel.
+
+      The range [0, numberOfIterations) is split into blocks, and each block
+      is reduced into its own partial result on a separate cache line, so
+      threads never write to shared memory while the loop runs. The partial
+      results are then combined pairwise in a tree. The storage for the
+      partial results comes from the ThreadGroup allocator.
+
+      This example computes the largest absolute sample value:
+
+      @code
+
+      struct Peak
+      {
+        float const* samples;
+        float operator() (int i) const { return std::abs (samples [i]); }
+      };
+
+      float maxOf (float a, float b) { return std::max (a, b); }
+
+      Peak peak = { samples };
+
+      float level = ParallelFor().reduce (numberOfSamples, 0.f, peak, &maxOf);
+
+      @endcode
+
+      combineFn must be associative. It does not have to be commutative,
+      since partial results are always combined in index order.
+
+      The schedule set with setSchedule() is ignored. Each block is a fixed
+      range of indices run in order on one thread, and the blocks are handed
+      out one at a time as with Schedule::dynamic (1).
+
+      @param numberOfIterations The number of indices to reduce.
+
+      @param identity           The identity element for combineFn, which is
+                                the result when there are no iterations.
+
+      @param mapFn              A functor called as `T mapFn (int index)`.
+
+      @param combineFn          A functor called as `T combineFn (T, T)`.
+
+      @return The combination of mapFn (i) for every index.
+  */
+  template <class T, class MapFn, class CombineFn>
+  T reduce (int numberOfIterations,
+            T const& identity,
+            MapFn mapFn,
+            CombineFn combineFn)
+  {
+    if (numberOfIterations <= 0)
+      return identity;
+
+    int const numberOfBlocks = getNumberOfBlocks (numberOfIterations);
+
+    Partials <T> partials (m_pool.getAllocator (), numberOfBlocks, identity);
+
+    loopBlocksf (numberOfBlocks, ReduceBlock <T, MapFn, CombineFn> (
+      partials, numberOfIterations, numberOfBlocks, mapFn, combineFn));
+
+    // Combine the partial results pairwise in a tree.
+    for (int step = 1; step < numberOfBlocks; step *= 2)
+      for (int i = 0; i + step < numberOfBlocks; i += 2 * step)
+        partials [i] = combineFn (partials [i], partials [i + step]);
+
+    return partials [0];
+  }
+
+  /** Compute a prefix scan in parallel.
+
+      For each index, outputFn receives the combination of mapFn for all the
+      indices up to and including it (inclusiveScan) or for all the indices
+      before it (exclusiveScan). With addition as combineFn, these are the
+      familiar prefix sums.
+
+      The work is done in two parallel passes over blocks. The first pass
+      reduces each block to a partial result. The partial results are scanned
+      to find the starting value of each block, and the second pass scans each
+      block from its starting value and produces the output.
+
+      combineFn must be associative. Because mapFn is called twice for each
+      index, it should be inexpensive and free of side effects.
+
+      As with reduce(), the schedule set with setSchedule() is ignored.
+
+      @param numberOfIterations The number of indices to scan.
+
+      @param identity           The identity element for combineFn.
+
+      @param mapFn              A functor called as `T mapFn (int index)`.
+
+      @param combineFn          A functor called as `T combineFn (T, T)`.
+
+      @param outputFn           A functor called as
+                                `outputFn (int index, T value)` once for
+                                each index, in no particular order.
+  */
+  /** @{ */
+  template <class T, class MapFn, class CombineFn, class OutputFn>
+  void inclusiveScan (int numberOfIterations,
+                      T const& identity,
+                      MapFn mapFn,
+                      CombineFn combineFn,
+                      OutputFn outputFn)
+  {
+    scan (numberOfIterations, identity, mapFn, combineFn, outputFn, true);
+  }
+
+  template <class T, class MapFn, class CombineFn, class OutputFn>
+  void exclusiveScan (int numberOfIterations,
+                      T const& identity,
+                      MapFn mapFn,
+                      CombineFn combineFn,
+                      OutputFn outputFn)
+  {
+    scan (numberOfIterations, identity, mapFn, combineFn, outputFn, false);
+  }
+  /** @} */
+
 private:
+  /* The loop body, called with a sub-range of indices.
+  */
   class Iteration
   {
   public:
     virtual ~Iteration () { }
-    virtual void operator () (int loopIndex) = 0;
+    virtual void operator () (int begin, int end) = 0;
   };
 
   template <class Functor>
@@ -160,15 +440,258 @@ private:
     {
     }
 
-    void operator () (int loopIndex)
+    void operator () (int begin, int end)
     {
-      m_f (loopIndex);
+      for (int loopIndex = begin; loopIndex < end; ++loopIndex)
+        m_f (loopIndex);
+    }
+
+  private:
+    Functor m_f;
+  };
+
+  template <class Functor>
+  class RangeIterationType : public Iteration, Uncopyable
+  {
+  public:
+    explicit RangeIterationType (Functor const& f) : m_f (f)
+    {
+    }
+
+    void operator () (int begin, int end)
+    {
+      m_f (begin, end);
     }
 
   private:
     Functor m_f;
   };
 
+private:
+  enum
+  {
+    /** Blocks per thread used by reduce() and scan(), for load balancing. */
+    blocksPerThread = 4
+  };
+
+  int getNumberOfBlocks (int numberOfIterations) const;
+
+  // Runs one call per block. The blocks are already sized for load
+  // balancing, so they are always handed out one at a time. Chunking
+  // them by the user's schedule could put every block on one thread.
+  //
+  template <class Functor>
+  void loopBlocksf (int numberOfBlocks, Functor const& f)
+  {
+    IterationType <Functor> iteration (f);
+
+    doLoop (numberOfBlocks, iteration, Schedule::dynamic (1));
+  }
+
+  // Holds one partial result per block. Each partial result is on its own
+  // cache lines, and the memory comes from the ThreadGroup allocator.
+  //
+  template <class T>
+  class Partials : Uncopyable
+  {
+  public:
+    Partials (ThreadGroup::AllocatorType& allocator,
+              int numberOfBlocks,
+              T const& identity)
+      : m_numberOfBlocks (numberOfBlocks)
+      , m_slots (static_cast <Slot*> (allocator.allocate (
+          numberOfBlocks * sizeof (Slot))))
+    {
+      size_t const bytes = (sizeof (T) + Memory::cacheLineAlignMask)
+                           & ~size_t (Memory::cacheLineAlignMask);
+
+      for (int i = 0; i < m_numberOfBlocks; ++i)
+      {
+        // Extra room to start the value on a cache line boundary.
+        void* const storage = allocator.allocate (bytes + Memory::cacheLineAlignBytes);
+
+        m_slots [i].storage = storage;
+        m_slots [i].value = new ((void*)((uintptr_t (storage) + Memory::cacheLineAlignMask)
+          & ~uintptr_t (Memory::cacheLineAlignMask))) T (identity);
+      }
+    }
+
+    ~Partials ()
+    {
+      for (int i = 0; i < m_numberOfBlocks; ++i)
+      {
+        m_slots [i].value->~T ();
+
+        ThreadGroup::AllocatorType::deallocate (m_slots [i].storage);
+      }
+
+      ThreadGroup::AllocatorType::deallocate (m_slots);
+    }
+
+    inline T& operator[] (int index)
+    {
+      return *m_slots [index].value;
+    }
+
+  private:
+    struct Slot
+    {
+      void* storage;
+      T* value;
+    };
+
+    int const m_numberOfBlocks;
+    Slot* const m_slots;
+  };
+
+  // Determines the range of indices in a block.
+  //
+  class Blocks
+  {
+  public:
+    Blocks (int numberOfIterations, int numberOfBlocks)
+      : m_numberOfIterations (numberOfIterations)
+      , m_blockSize ((numberOfIterations + numberOfBlocks - 1) / numberOfBlocks)
+    {
+    }
+
+    inline int begin (int block) const
+    {
+      return std::min (m_numberOfIterations, block * m_blockSize);
+    }
+
+    inline int end (int block) const
+    {
+      return std::min (m_numberOfIterations, (block + 1) * m_blockSize);
+    }
+
+  private:
+    int m_numberOfIterations;
+    int m_blockSize;
+  };
+
+  // Reduces a block into its partial result.
+  //
+  template <class T, class MapFn, class CombineFn>
+  class ReduceBlock
+  {
+  public:
+    ReduceBlock (Partials <T>& partials,
+                 int numberOfIterations,
+                 int numberOfBlocks,
+                 MapFn const& mapFn,
+                 CombineFn const& combineFn)
+      : m_partials (partials)
+      , m_blocks (numberOfIterations, numberOfBlocks)
+      , m_mapFn (mapFn)
+      , m_combineFn (combineFn)
+    {
+    }
+
+    void operator() (int block)
+    {
+      int const end = m_blocks.end (block);
+
+      T& partial = m_partials [block];
+
+      for (int i = m_blocks.begin (block); i < end; ++i)
+        partial = m_combineFn (partial, m_mapFn (i));
+    }
+
+  private:
+    Partials <T>& m_partials;
+    Blocks m_blocks;
+    MapFn m_mapFn;
+    CombineFn m_combineFn;
+  };
+
+  // Scans a block starting from its partial result.
+  //
+  template <class T, class MapFn, class CombineFn, class OutputFn>
+  class ScanBlock
+  {
+  public:
+    ScanBlock (Partials <T>& partials,
+               int numberOfIterations,
+               int numberOfBlocks,
+               MapFn const& mapFn,
+               CombineFn const& combineFn,
+               OutputFn const& outputFn,
+               bool inclusive)
+      : m_partials (partials)
+      , m_blocks (numberOfIterations, numberOfBlocks)
+      , m_mapFn (mapFn)
+      , m_combineFn (combineFn)
+      , m_outputFn (outputFn)
+      , m_inclusive (inclusive)
+    {
+    }
+
+    void operator() (int block)
+    {
+      int const end = m_blocks.end (block);
+
+      T& running = m_partials [block];
+
+      for (int i = m_blocks.begin (block); i < end; ++i)
+      {
+        if (m_inclusive)
+        {
+          running = m_combineFn (running, m_mapFn (i));
+          m_outputFn (i, running);
+        }
+        else
+        {
+          m_outputFn (i, running);
+          running = m_combineFn (running, m_mapFn (i));
+        }
+      }
+    }
+
+  private:
+    Partials <T>& m_partials;
+    Blocks m_blocks;
+    MapFn m_mapFn;
+    CombineFn m_combineFn;
+    OutputFn m_outputFn;
+    bool const m_inclusive;
+  };
+
+  template <class T, class MapFn, class CombineFn, class OutputFn>
+  void scan (int numberOfIterations,
+             T const& identity,
+             MapFn mapFn,
+             CombineFn combineFn,
+             OutputFn outputFn,
+             bool inclusive)
+  {
+    if (numberOfIterations <= 0)
+      return;
+
+    int const numberOfBlocks = getNumberOfBlocks (numberOfIterations);
+
+    Partials <T> partials (m_pool.getAllocator (), numberOfBlocks, identity);
+
+    loopBlocksf (numberOfBlocks, ReduceBlock <T, MapFn, CombineFn> (
+      partials, numberOfIterations, numberOfBlocks, mapFn, combineFn));
+
+    // Replace each partial result with the starting value of its block.
+    {
+      T running (identity);
+
+      for (int i = 0; i < numberOfBlocks; ++i)
+      {
+        T const partial (partials [i]);
+        partials [i] = running;
+        running = combineFn (running, partial);
+      }
+    }
+
+    loopBlocksf (numberOfBlocks, ScanBlock <T, MapFn, CombineFn, OutputFn> (
+      partials, numberOfIterations, numberOfBlocks,
+      mapFn, combineFn, outputFn, inclusive));
+  }
+
 private:
   class LoopState
     : public AllocatedBy <ThreadGroup::AllocatorType>
@@ -177,7 +700,11 @@ private:
   private:
     Iteration& m_iteration;
     WaitableEvent& m_finishedEvent;
+    Schedule const m_schedule;
+    CancellationToken const* const m_cancellationToken;
     int const m_numberOfIterations;
+    int const m_numberOfInstances;
+    Atomic <int> m_instanceIndex;
     Atomic <int> m_loopIndex;
     Atomic <int> m_iterationsRemaining;
     Atomic <int> m_numberOfParallelInstances;
@@ -185,12 +712,18 @@ private:
   public:
     LoopState (Iteration& iteration,
                WaitableEvent& finishedEvent,
+               Schedule const& schedule,
+               CancellationToken const* cancellationToken,
                int numberOfIterations,
                int numberOfParallelInstances)
       : m_iteration (iteration)
       , m_finishedEvent (finishedEvent)
+      , m_schedule (schedule)
+      , m_cancellationToken (cancellationToken)
       , m_numberOfIterations (numberOfIterations)
-      , m_loopIndex (-1)
+      , m_numberOfInstances (numberOfParallelInstances)
+      , m_instanceIndex (-1)
+      , m_loopIndex (0)
       , m_iterationsRemaining (numberOfIterations)
       , m_numberOfParallelInstances (numberOfParallelInstances)
     {
@@ -202,33 +735,99 @@ private:
 
     void forLoopBody ()
     {
-      for (;;)
+      // Each parallel instance gets its own number, used
+      // to pick its chunks when the schedule is static.
+      //
+      int const instance = ++m_instanceIndex;
+      int chunkIndex = instance;
+
+      int begin;
+      int end;
+
+      // Request a range of indices to process.
+      while (claim (chunkIndex, begin, end))
       {
-        // Request a loop index to process.
-        int const loopIndex = ++m_loopIndex;
+        // A cancelled range still counts as done, so the loop finishes.
+        if (m_cancellationToken == nullptr || ! m_cancellationToken->isCancelled ())
+          m_iteration (begin, end);
 
-        // Is it in range?
-        if (loopIndex < m_numberOfIterations)
+        // Was this the last work item to complete?
+        if ((m_iterationsRemaining -= (end - begin)) == 0)
         {
-          // Yes, so process it.
-          m_iteration (loopIndex);
+          // Yes, signal.
+          m_finishedEvent.signal ();
+          break;
+        }
+      }
 
-          // Was this the last work item to complete?
-          if (--m_iterationsRemaining == 0)
+      release ();
+    }
+
+    // Returns false when all work is complete or assigned.
+    //
+    bool claim (int& chunkIndex, int& begin, int& end)
+    {
+      int const n = m_numberOfIterations;
+
+      switch (m_schedule.m_type)
+      {
+      case Schedule::typeStatic:
+        {
+          int chunkSize = m_schedule.m_chunkSize;
+
+          if (chunkSize == 0)
+            chunkSize = (n + m_numberOfInstances - 1) / m_numberOfInstances;
+
+          // Avoid overflow when the index is far past the end.
+          if (chunkIndex >= (n + chunkSize - 1) / chunkSize)
+            return false;
+
+          begin = chunkIndex * chunkSize;
+          end = std::min (n, begin + chunkSize);
+          chunkIndex += m_numberOfInstances;
+        }
+        break;
+
+      case Schedule::typeGuided:
+        {
+          for (;;)
           {
-            // Yes, signal.
-            m_finishedEvent.signal ();
-            break;
+            begin = m_loopIndex.get ();
+
+            if (begin >= n)
+              return false;
+
+            // Take a fraction of what is left, but at least the grain.
+            int const size = std::max (m_schedule.m_chunkSize,
+                                       (n - begin) / (2 * m_numberOfInstances));
+
+            end = std::min (n, begin + size);
+
+            if (m_loopIndex.compareAndSetBool (end, begin))
+              break;
           }
         }
-        else
+        break;
+
+      case Schedule::typeDynamic:
+      default:
         {
-          // Out of range, all work is complete or assigned.
-          break;
+          // Don't claim once the indices are used up, so
+          // the counter stops growing and can't overflow.
+          if (m_loopIndex.get () >= n)
+            return false;
+
+          begin = (m_loopIndex += m_schedule.m_chunkSize) - m_schedule.m_chunkSize;
+
+          if (begin >= n)
+            return false;
+
+          end = std::min (n, begin + m_schedule.m_chunkSize);
         }
+        break;
       }
 
-      release ();
+      return true;
     }
 
     void release ()
@@ -241,8 +840,14 @@ private:
 private:
   void doLoop (int numberOfIterations, Iteration& iteration);
 
+  void doLoop (int numberOfIterations,
+               Iteration& iteration,
+               Schedule const& schedule);
+
 private:
   ThreadGroup& m_pool;
+  Schedule m_schedule;
+  CancellationToken const* m_cancellationToken;
   WaitableEvent m_finishedEvent;
   Atomic <int> m_currentIndex;
   Atomic <int> m_numberOfInstances;
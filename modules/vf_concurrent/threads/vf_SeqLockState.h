@@ -0,0 +1,230 @@
+/*============================================================================*/
+/*
+  VFLib: https://github.com/vinniefalco/VFLib
+
+  Copyright (C) 2008 by Vinnie Falco <vinnie.falco@gmail.com>
+
+  This library contains portions of other open source products covered by
+  separate licenses. Please see the corresponding source files for specific
+  terms.
+  
+  VFLib is provided under the terms of The MIT License (MIT):
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+  IN THE SOFTWARE.
+*/
+/*============================================================================*/
+
+#ifndef VF_SEQLOCKSTATE_VFHEADER
+#define VF_SEQLOCKSTATE_VFHEADER
+
+/*============================================================================*/
+/** 
+  Structured access to a small shared state, using a sequence lock.
+
+  This offers the same typed accessor interface as ConcurrentState, for
+  states made of a handful of plain values such as a transport position,
+  a tempo or meter levels. Instead of a lock, the state carries a sequence
+  number which the writer makes odd while it is changing the object.
+
+  - ReadAccess
+
+    Copies the object into the ReadAccess. The copy is taken optimistically
+    and taken again if the sequence number shows that a write overlapped
+    it. Readers never write to shared memory, so any number of them can read
+    without cache line traffic between them, and they never delay the writer.
+
+  - WriteAccess
+
+    Allows read/write access to the object in place. The writer never waits.
+    Only one WriteAccess may exist at a time; if several threads write, the
+    caller must serialize them.
+
+  A reader only retries while a write is in progress, so keep write
+  accesses short.
+
+  @code
+
+  struct Transport
+  {
+    double position;
+    float tempo;
+  };
+
+  typedef SeqLockState <Transport> TransportState;
+
+  TransportState transportState;
+
+  void audioCallback ()
+  {
+    TransportState::WriteAccess state (transportState);
+
+    state->position += 512;
+  }
+
+  void paint ()
+  {
+    TransportState::ReadAccess state (transportState);
+
+    print (state->position);
+  }
+
+  @endcode
+
+  @param Object The type of object to encapsulate. It must be trivially
+                copyable, since readers copy it with memcpy() while it may
+                be changing, and default constructible.
+
+  @see ConcurrentState
+
+  @ingroup vf_concurrent
+*/
+template <class Object>
+class SeqLockState : Uncopyable
+{
+public:
+  class ReadAccess;
+  class WriteAccess;
+
+  /** Create a state with a default constructed Object. */
+  SeqLockState ()
+    : m_sequence (0)
+  {
+  }
+
+  /** Create a state with a copy of an Object. */
+  explicit SeqLockState (Object const& object)
+    : m_sequence (0)
+    , m_obj (object)
+  {
+  }
+
+private:
+  // Reads the sequence number with plain loads. Atomic::get() may be
+  // implemented as an interlocked add, which would write to the line.
+  //
+  int getSequence () const noexcept
+  {
+    Atomic <int>::memoryBarrier ();
+    int const sequence = m_sequence.value;
+    Atomic <int>::memoryBarrier ();
+    return sequence;
+  }
+
+  void read (Object* object) const noexcept
+  {
+    for (;;)
+    {
+      int const before = getSequence ();
+
+      if ((before & 1) == 0)
+      {
+        memcpy (object, &m_obj, sizeof (Object));
+
+        if (getSequence () == before)
+          break;
+      }
+    }
+  }
+
+  void beginWrite () noexcept
+  {
+    int const sequence = ++m_sequence;
+
+    // Only one WriteAccess may exist at a time.
+    jassert ((sequence & 1) == 1);
+    (void)sequence;
+  }
+
+  void endWrite () noexcept
+  {
+    ++m_sequence;
+  }
+
+private:
+  Atomic <int> m_sequence;
+  Object m_obj;
+};
+
+//------------------------------------------------------------------------------
+
+/** Read only access to a copy of a SeqLockState */
+template <class Object>
+class SeqLockState <Object>::ReadAccess : Uncopyable
+{
+public:
+  /** Create a ReadAccess from the specified SeqLockState */
+  explicit ReadAccess (SeqLockState const volatile& state)
+  {
+    const_cast <SeqLockState const&> (state).read (&m_obj);
+  }
+
+  /** Obtain a read only reference to Object */
+  Object const& getObject () const { return m_obj; }
+
+  /** Obtain a read only reference to Object */
+  Object const& operator* () const { return getObject(); }
+
+  /** Obtain a read only smart pointer to Object */
+  Object const* operator->() const { return &getObject(); }
+
+private:
+  Object m_obj;
+};
+
+//------------------------------------------------------------------------------
+
+/** Read/write access to a SeqLockState */
+template <class Object>
+class SeqLockState <Object>::WriteAccess : Uncopyable
+{
+public:
+  explicit WriteAccess (SeqLockState& state)
+    : m_state (state)
+  {
+    m_state.beginWrite ();
+  }
+
+  ~WriteAccess ()
+  {
+    m_state.endWrite ();
+  }
+
+  /** Obtain a read only reference to Object */
+  Object const& getObject () const { return m_state.m_obj; }
+
+  /** Obtain a read only reference to Object */
+  Object const& operator* () const { return getObject(); }
+
+  /** Obtain a read only smart pointer to Object */
+  Object const* operator->() const { return &getObject(); }
+
+  /** Obtain a read/write reference to Object */
+  Object& getObject () { return m_state.m_obj; }
+
+  /** Obtain a read/write reference to Object */
+  Object& operator* () { return getObject(); }
+
+  /** Obtain a read/write smart pointer to Object */
+  Object* operator->() { return &getObject(); }
+
+private:
+  SeqLockState& m_state;
+};
+
+#endif
@@ -0,0 +1,307 @@
+/*============================================================================*/
+/*
+  VFLib: https://github.com/vinniefalco/VFLib
+
+  Copyright (C) 2008 by Vinnie Falco <vinnie.falco@gmail.com>
+
+  This library contains portions of other open source products covered by
+  separate licenses. Please see the corresponding source files for specific
+  terms.
+  
+  VFLib is provided under the terms of The MIT License (MIT):
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+  IN THE SOFTWARE.
+*/
+/*============================================================================*/
+
+#ifndef VF_SNAPSHOTSTATE_VFHEADER
+#define VF_SNAPSHOTSTATE_VFHEADER
+
+/*============================================================================*/
+/** 
+  Structured access to a shared state, using immutable snapshots.
+
+  This offers the same typed accessor interface as ConcurrentState, but
+  readers never block. Instead of locking the object, a ReadAccess takes a
+  reference to the current version of the object, which stays unchanged
+  for as long as the ReadAccess exists. A WriteAccess works on a private copy
+  of the current version, and publishes it as the new version when the
+  WriteAccess is destroyed. Readers which started earlier keep seeing the
+  version they obtained.
+
+  - ReadAccess
+
+    Allows read access to the current snapshot as `const`. Obtaining it costs
+    a few atomic operations and never waits for a writer, which makes it
+    suitable for real-time threads such as an AudioIODeviceCallback.
+
+  - WriteAccess
+
+    Allows read/write access to a copy of the object. Write accesses are
+    serialized with respect to each other, but do not affect readers until
+    the WriteAccess is destroyed. Publishing waits briefly for readers which
+    are in the middle of taking a reference to the old version.
+
+  Versions are reference counted ConcurrentObject instances. When the last
+  reference to an old version goes away, even on a real-time thread, the
+  version is deleted on the separate thread provided by ConcurrentObject.
+
+  @code
+
+  struct SharedData
+  {
+    int value1;
+    String value2;
+  };
+
+  typedef SnapshotState <SharedData> SharedState;
+
+  SharedState sharedState;
+
+  void audioCallback ()
+  {
+    SharedState::ReadAccess state (sharedState); // never blocks
+
+    print (state->value1);
+  }
+
+  void writeExample ()
+  {
+    SharedState::WriteAccess state (sharedState);
+
+    state->value2 = "Label"; // visible to new readers after this scope
+  }
+
+  @endcode
+
+  @param Object The type of object to encapsulate. It must be copy
+                constructible.
+
+  @see ConcurrentState, ConcurrentObject
+
+  @ingroup vf_concurrent
+*/
+template <class Object>
+class SnapshotState : Uncopyable
+{
+public:
+  class ReadAccess;
+  class WriteAccess;
+
+  /** Create a snapshot state.
+
+      Up to 8 parameters can be specified in the constructor. These parameters
+      are forwarded to the corresponding constructor in Object. If no
+      constructor in Object matches the parameter list, a compile error is
+      generated.
+  */
+  /** @{ */
+  SnapshotState ()
+    { init (new Version (Object ())); }
+
+  template <class T1>
+  explicit SnapshotState (T1 t1)
+    { init (new Version (Object (t1))); }
+
+  template <class T1, class T2>
+  SnapshotState (T1 t1, T2 t2)
+    { init (new Version (Object (t1, t2))); }
+
+  template <class T1, class T2, class T3>
+  SnapshotState (T1 t1, T2 t2, T3 t3)
+    { init (new Version (Object (t1, t2, t3))); }
+
+  template <class T1, class T2, class T3, class T4>
+  SnapshotState (T1 t1, T2 t2, T3 t3, T4 t4)
+    { init (new Version (Object (t1, t2, t3, t4))); }
+
+  template <class T1, class T2, class T3, class T4, class T5>
+  SnapshotState (T1 t1, T2 t2, T3 t3, T4 t4, T5 t5)
+    { init (new Version (Object (t1, t2, t3, t4, t5))); }
+
+  template <class T1, class T2, class T3, class T4, class T5, class T6>
+  SnapshotState (T1 t1, T2 t2, T3 t3, T4 t4, T5 t5, T6 t6)
+    { init (new Version (Object (t1, t2, t3, t4, t5, t6))); }
+
+  template <class T1, class T2, class T3, class T4, class T5, class T6, class T7>
+  SnapshotState (T1 t1, T2 t2, T3 t3, T4 t4, T5 t5, T6 t6, T7 t7)
+    { init (new Version (Object (t1, t2, t3, t4, t5, t6, t7))); }
+
+  template <class T1, class T2, class T3, class T4, class T5, class T6, class T7, class T8>
+  SnapshotState (T1 t1, T2 t2, T3 t3, T4 t4, T5 t5, T6 t6, T7 t7, T8 t8)
+    { init (new Version (Object (t1, t2, t3, t4, t5, t6, t7, t8))); }
+  /** @} */
+
+  /** Destroy the state.
+
+      Snapshots still held by a ReadAccess remain valid.
+  */
+  ~SnapshotState ()
+  {
+    m_current->decReferenceCount ();
+  }
+
+private:
+  class Version : public ConcurrentObject
+  {
+  public:
+    typedef ReferenceCountedObjectPtr <Version> Ptr;
+
+    explicit Version (Object const& object) : m_obj (object) { }
+
+    Object m_obj;
+  };
+
+  void init (Version* version)
+  {
+    version->incReferenceCount ();
+    m_current = version;
+    m_phase.set (0);
+  }
+
+  // A reader registers in the counter for the current phase before it
+  // loads the pointer, and leaves once it holds a reference. If the phase
+  // changed while registering it backs off and tries again, so a writer
+  // only has to wait for the readers of the phase it retired.
+  //
+  typename Version::Ptr acquire () const
+  {
+    for (;;)
+    {
+      int const phase = m_phase.get ();
+
+      ++(*m_readers [phase]);
+
+      if (m_phase.get () == phase)
+      {
+        typename Version::Ptr version (m_current.get ());
+
+        --(*m_readers [phase]);
+
+        return version;
+      }
+
+      --(*m_readers [phase]);
+    }
+  }
+
+  // Called with m_writeMutex held.
+  void publish (Version* version)
+  {
+    version->incReferenceCount ();
+
+    Version* const old = m_current.exchange (version);
+
+    int const phase = m_phase.get ();
+
+    m_phase.set (phase ^ 1);
+
+    // Anyone still registered in the old phase may
+    // be about to take a reference to the old version.
+    if (m_readers [phase]->get () != 0)
+    {
+      SpinDelay delay;
+      do
+      {
+        delay.pause ();
+      }
+      while (m_readers [phase]->get () != 0);
+    }
+
+    old->decReferenceCount ();
+  }
+
+private:
+  AtomicPointer <Version> m_current;
+  mutable Atomic <int> m_phase;
+  mutable CacheLine::Padded <Atomic <int> > m_readers [2];
+  CriticalSection m_writeMutex;
+};
+
+//------------------------------------------------------------------------------
+
+/** Read only access to a SnapshotState */
+template <class Object>
+class SnapshotState <Object>::ReadAccess : Uncopyable
+{
+public:
+  /** Create a ReadAccess from the specified SnapshotState */
+  explicit ReadAccess (SnapshotState const volatile& state)
+    : m_version (const_cast <SnapshotState const&> (state).acquire ())
+  {
+  }
+
+  /** Obtain a read only reference to Object */
+  Object const& getObject () const { return m_version->m_obj; }
+
+  /** Obtain a read only reference to Object */
+  Object const& operator* () const { return getObject(); }
+
+  /** Obtain a read only smart pointer to Object */
+  Object const* operator->() const { return &getObject(); }
+
+private:
+  typename Version::Ptr const m_version;
+};
+
+//------------------------------------------------------------------------------
+
+/** Read/write access to a copy of a SnapshotState */
+template <class Object>
+class SnapshotState <Object>::WriteAccess : Uncopyable
+{
+public:
+  explicit WriteAccess (SnapshotState& state)
+    : m_state (state)
+    , m_lock (m_state.m_writeMutex)
+    , m_version (new Version (m_state.m_current->m_obj))
+  {
+  }
+
+  /** Publish the modified copy. */
+  ~WriteAccess ()
+  {
+    m_state.publish (m_version);
+  }
+
+  /** Obtain a read only reference to Object */
+  Object const& getObject () const { return m_version->m_obj; }
+
+  /** Obtain a read only reference to Object */
+  Object const& operator* () const { return getObject(); }
+
+  /** Obtain a read only smart pointer to Object */
+  Object const* operator->() const { return &getObject(); }
+
+  /** Obtain a read/write reference to Object */
+  Object& getObject () { return m_version->m_obj; }
+
+  /** Obtain a read/write reference to Object */
+  Object& operator* () { return getObject(); }
+
+  /** Obtain a read/write smart pointer to Object */
+  Object* operator->() { return &getObject(); }
+
+private:
+  SnapshotState& m_state;
+  CriticalSection::ScopedLockType m_lock;
+  typename Version::Ptr const m_version;
+};
+
+#endif
@@ -0,0 +1,170 @@
+/*============================================================================*/
+/*
+  VFLib: https://github.com/vinniefalco/VFLib
+
+  Copyright (C) 2008 by Vinnie Falco <vinnie.falco@gmail.com>
+
+  This library contains portions of other open source products covered by
+  separate licenses. Please see the corresponding source files for specific
+  terms.
+  
+  VFLib is provided under the terms of The MIT License (MIT):
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+  IN THE SOFTWARE.
+*/
+/*============================================================================*/
+
+TaskGraph::Task::Task ()
+  : m_successors (nullptr)
+  , m_numberOfPredecessors (0)
+{
+}
+
+TaskGraph::Task::~Task ()
+{
+  Edge* edge = m_successors;
+
+  while (edge != nullptr)
+  {
+    Edge* const next = edge->m_next;
+    delete edge;
+    edge = next;
+  }
+}
+
+//------------------------------------------------------------------------------
+
+TaskGraph::TaskGraph (ThreadGroup& group)
+  : m_group (group)
+  , m_finishedEvent (false) // auto-reset
+  , m_running (false)
+{
+}
+
+TaskGraph::~TaskGraph ()
+{
+  clear ();
+}
+
+void TaskGraph::addDependency (Task* dependent, Task* prerequisite)
+{
+  jassert (! m_running);
+  jassert (dependent != prerequisite);
+
+  prerequisite->m_successors = new (m_group.getAllocator ()) Edge (
+    dependent, prerequisite->m_successors);
+
+  ++dependent->m_numberOfPredecessors;
+}
+
+void TaskGraph::run ()
+{
+  jassert (! m_running);
+
+  if (! m_tasks.empty ())
+  {
+    m_running = true;
+
+    m_tasksRemaining.set (int (m_tasks.size ()));
+
+    // All counters must be reset before the first task is released,
+    // since a finished task decrements the counters of its successors.
+    //
+    for (List <Task>::iterator iter = m_tasks.begin (); iter != m_tasks.end (); ++iter)
+      iter->m_pendingPredecessors.set (iter->m_numberOfPredecessors);
+
+    bool foundRoot = false;
+
+    for (List <Task>::iterator iter = m_tasks.begin (); iter != m_tasks.end (); ++iter)
+    {
+      if (iter->m_numberOfPredecessors == 0)
+      {
+        foundRoot = true;
+
+        release (&*iter);
+      }
+    }
+
+    // A graph where every task has a prerequisite contains a cycle.
+    jassert (foundRoot);
+
+    if (foundRoot)
+      m_finishedEvent.wait ();
+
+    m_running = false;
+  }
+}
+
+void TaskGraph::clear ()
+{
+  jassert (! m_running);
+
+  while (! m_tasks.empty ())
+  {
+    Task& task (m_tasks.front ());
+
+    m_tasks.pop_front ();
+
+    delete &task;
+  }
+}
+
+TaskGraph::Task* TaskGraph::addTask (Task* task)
+{
+  jassert (! m_running);
+
+  m_tasks.push_back (*task);
+
+  return task;
+}
+
+void TaskGraph::release (Task* task)
+{
+  m_group.call (1, &TaskGraph::execute, this, task);
+}
+
+void TaskGraph::execute (Task* task)
+{
+  while (task != nullptr)
+  {
+    (*task) ();
+
+    // Release the successors whose last prerequisite was this task. The
+    // first one continues on this thread, which saves a trip through the
+    // ThreadGroup and keeps the data it shares with this task in the cache.
+    //
+    Task* continuation = nullptr;
+
+    for (Edge* edge = task->m_successors; edge != nullptr; edge = edge->m_next)
+    {
+      if (--edge->m_task->m_pendingPredecessors == 0)
+      {
+        if (continuation == nullptr)
+          continuation = edge->m_task;
+        else
+          release (edge->m_task);
+      }
+    }
+
+    if (--m_tasksRemaining == 0)
+      m_finishedEvent.signal ();
+
+    task = continuation;
+  }
+}
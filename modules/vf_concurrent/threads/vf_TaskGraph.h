@@ -0,0 +1,229 @@
+/*============================================================================*/
+/*
+  VFLib: https://github.com/vinniefalco/VFLib
+
+  Copyright (C) 2008 by Vinnie Falco <vinnie.falco@gmail.com>
+
+  This library contains portions of other open source products covered by
+  separate licenses. Please see the corresponding source files for specific
+  terms.
+  
+  VFLib is provided under the terms of The MIT License (MIT):
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+  IN THE SOFTWARE.
+*/
+/*============================================================================*/
+
+#ifndef VF_TASKGRAPH_VFHEADER
+#define VF_TASKGRAPH_VFHEADER
+
+/*============================================================================*/
+/**
+  @ingroup vf_concurrent
+
+  @brief Runs a graph of dependent tasks on a ThreadGroup.
+
+  A task graph holds a set of tasks and the dependencies between them. When
+  the graph runs, each task goes to the ThreadGroup as soon as all of its
+  prerequisites have finished, so independent stages overlap without any
+  bookkeeping by the caller. Every task keeps an atomic count of the
+  prerequisites that have not finished yet. The task which takes the count
+  to zero releases the dependent task. One released task continues directly
+  on the thread that released it, and the rest go to the ThreadGroup.
+
+  Tasks and their dependency edges come from the ThreadGroup allocator, so
+  building a graph does not call the system heap. A graph can be run any
+  number of times, or cleared and rebuilt. For example, a graph can be
+  built once per audio frame:
+
+  @code
+
+  TaskGraph graph;
+
+  TaskGraph::Task* decode   = graph.add (&Decoder::decode, &decoder, frame);
+  TaskGraph::Task* dsp      = graph.add (&Processor::process, &processor, frame);
+  TaskGraph::Task* analysis = graph.add (&Analyzer::analyze, &analyzer, frame);
+  TaskGraph::Task* write    = graph.add (&Database::write, &db, frame);
+
+  graph.addDependency (dsp, decode);
+  graph.addDependency (analysis, decode);  // runs alongside dsp
+  graph.addDependency (write, dsp);
+  graph.addDependency (write, analysis);
+
+  graph.run ();
+
+  @endcode
+
+  The graph must be acyclic. run() blocks until every task finishes, so it
+  must not be called from a task running on the same ThreadGroup.
+
+  @see ThreadGroup, ParallelFor
+*/
+class TaskGraph : Uncopyable
+{
+private:
+  typedef ThreadGroup::AllocatorType AllocatorType;
+
+  class Edge;
+
+public:
+  /** A task in the graph.
+
+      A Task is owned by its graph and used as an opaque handle for
+      declaring dependencies.
+  */
+  class Task
+    : public List <Task>::Node
+    , public AllocatedBy <AllocatorType>
+  {
+  protected:
+    Task ();
+
+    virtual ~Task ();
+
+    virtual void operator() () = 0;
+
+  private:
+    friend class TaskGraph;
+
+    Edge* m_successors;
+    int m_numberOfPredecessors;
+    Atomic <int> m_pendingPredecessors;
+  };
+
+  /** Create an empty graph.
+
+      @param group The ThreadGroup to run the tasks on. If omitted, the
+                   global ThreadGroup is used.
+  */
+  explicit TaskGraph (ThreadGroup& group = *GlobalThreadGroup::getInstance ());
+
+  ~TaskGraph ();
+
+  /** Add a task to the graph.
+
+      The task runs when the graph runs, after all of its prerequisites
+      have finished.
+
+      @return A handle for declaring dependencies.
+  */
+  /** @{ */
+  template <class Functor>
+  Task* addf (Functor f)
+  {
+    return addTask (new (m_group.getAllocator ()) TaskType <Functor> (f));
+  }
+
+  template <class Fn>
+  Task* add (Fn f)
+  { return addf (vf::bind (f)); }
+
+  template <class Fn, class T1>
+  Task* add (Fn f, T1 t1)
+  { return addf (vf::bind (f, t1)); }
+
+  template <class Fn, class T1, class T2>
+  Task* add (Fn f, T1 t1, T2 t2)
+  { return addf (vf::bind (f, t1, t2)); }
+
+  template <class Fn, class T1, class T2, class T3>
+  Task* add (Fn f, T1 t1, T2 t2, T3 t3)
+  { return addf (vf::bind (f, t1, t2, t3)); }
+
+  template <class Fn, class T1, class T2, class T3, class T4>
+  Task* add (Fn f, T1 t1, T2 t2, T3 t3, T4 t4)
+  { return addf (vf::bind (f, t1, t2, t3, t4)); }
+
+  template <class Fn, class T1, class T2, class T3, class T4, class T5>
+  Task* add (Fn f, T1 t1, T2 t2, T3 t3, T4 t4, T5 t5)
+  { return addf (vf::bind (f, t1, t2, t3, t4, t5)); }
+
+  template <class Fn, class T1, class T2, class T3, class T4, class T5, class T6>
+  Task* add (Fn f, T1 t1, T2 t2, T3 t3, T4 t4, T5 t5, T6 t6)
+  { return addf (vf::bind (f, t1, t2, t3, t4, t5, t6)); }
+
+  template <class Fn, class T1, class T2, class T3, class T4, class T5, class T6, class T7>
+  Task* add (Fn f, T1 t1, T2 t2, T3 t3, T4 t4, T5 t5, T6 t6, T7 t7)
+  { return addf (vf::bind (f, t1, t2, t3, t4, t5, t6, t7)); }
+
+  template <class Fn, class T1, class T2, class T3, class T4, class T5, class T6, class T7, class T8>
+  Task* add (Fn f, T1 t1, T2 t2, T3 t3, T4 t4, T5 t5, T6 t6, T7 t7, T8 t8)
+  { return addf (vf::bind (f, t1, t2, t3, t4, t5, t6, t7, t8)); }
+  /** @} */
+
+  /** Declare a dependency between two tasks.
+
+      The dependent task will not start until the prerequisite has finished.
+      Both tasks must belong to this graph. Dependencies cannot be added
+      while the graph is running.
+
+      @param dependent    The task which waits.
+
+      @param prerequisite The task which must finish first.
+  */
+  void addDependency (Task* dependent, Task* prerequisite);
+
+  /** Run all tasks and wait for them to finish.
+
+      Tasks with no prerequisites start immediately. The graph is left
+      intact, so it can be run again.
+  */
+  void run ();
+
+  /** Remove all tasks and dependencies from the graph.
+  */
+  void clear ();
+
+private:
+  template <class Functor>
+  class TaskType : public Task, LeakChecked <TaskType <Functor> >
+  {
+  public:
+    explicit TaskType (Functor const& f) : m_f (f) { }
+    ~TaskType () { }
+    void operator() () { m_f (); }
+
+  private:
+    Functor m_f;
+  };
+
+  class Edge
+    : public AllocatedBy <AllocatorType>
+    , LeakChecked <Edge>
+  {
+  public:
+    Edge (Task* task, Edge* next) : m_task (task), m_next (next) { }
+
+    Task* const m_task;
+    Edge* const m_next;
+  };
+
+  Task* addTask (Task* task);
+  void release (Task* task);
+  void execute (Task* task);
+
+private:
+  ThreadGroup& m_group;
+  WaitableEvent m_finishedEvent;
+  List <Task> m_tasks;
+  Atomic <int> m_tasksRemaining;
+  bool m_running;
+};
+
+#endif
@@ -30,47 +30,171 @@
 */
 /*============================================================================*/
 
-void ThreadGroup::QuitType::operator() (Worker* worker)
-{
-  worker->setShouldExit ();
-}
-
-//==============================================================================
-
-ThreadGroup::Worker::Worker (String name, ThreadGroup& group)
+ThreadGroup::Worker::Worker (String name, int index, ThreadGroup& group)
   : Thread (name)
   , m_group (group)
-  , m_shouldExit (false)
+  , m_index (index)
 {
-  startThread ();
 }
 
 ThreadGroup::Worker::~Worker ()
 {
   // Make sure the thread is stopped.
   stopThread (-1);
+
+  // There must not be pending work!
+  jassert (m_deque.empty ());
+  jassert (m_inbox.empty ());
 }
 
-void ThreadGroup::Worker::setShouldExit ()
+void ThreadGroup::Worker::push (Work* work)
 {
-  m_shouldExit = true;
+  LockType::ScopedLockType lock (m_mutex);
+
+  m_deque.push_back (*work);
 }
 
-void ThreadGroup::Worker::run ()
+// Called by threads outside the group.
+//
+void ThreadGroup::Worker::post (Work* work)
+{
+  m_inbox.push_front (work);
+}
+
+// Called by the owner, takes the newest work.
+//
+ThreadGroup::Work* ThreadGroup::Worker::popBack ()
+{
+  Work* work;
+
+  LockType::ScopedLockType lock (m_mutex);
+
+  if (!m_deque.empty ())
+  {
+    work = &m_deque.back ();
+    m_deque.pop_back ();
+  }
+  else
+  {
+    work = nullptr;
+  }
+
+  return work;
+}
+
+// Called by thieves, takes the oldest work.
+//
+ThreadGroup::Work* ThreadGroup::Worker::popFront ()
+{
+  Work* work;
+
+  LockType::ScopedLockType lock (m_mutex);
+
+  if (!m_deque.empty ())
+  {
+    work = &m_deque.front ();
+    m_deque.pop_front ();
+  }
+  else
+  {
+    work = nullptr;
+  }
+
+  return work;
+}
+
+// Called by any worker. Only the worker that empties the inbox sees the
+// work, so there is no ABA problem.
+//
+LockFreeStack <ThreadGroup::Work>::Chain ThreadGroup::Worker::popInbox ()
+{
+  return m_inbox.pop_all ();
+}
+
+// Called by the owner. Returns the oldest work in the chain, and moves the
+// rest onto our deque while taking the lock only once.
+//
+ThreadGroup::Work* ThreadGroup::Worker::adopt (LockFreeStack <Work>::Chain chain)
+{
+  chain.reverse ();
+
+  Work* const work = chain.pop_front ();
+
+  if (! chain.empty ())
+  {
+    LockType::ScopedLockType lock (m_mutex);
+
+    do
+    {
+      m_deque.push_back (*chain.pop_front ());
+    }
+    while (! chain.empty ());
+  }
+
+  return work;
+}
+
+// Returns nullptr when the group is stopping and there is no more work.
+//
+ThreadGroup::Work* ThreadGroup::Worker::waitForWork ()
 {
-  do
+  Work* work = m_group.findWork (this);
+
+  if (work == nullptr)
   {
-    m_group.m_semaphore.wait ();
+    // Spin for a while in case more work shows up soon.
+    SpinDelay delay;
 
-    Work* work = m_group.m_queue.pop_front ();
+    for (int i = 0; i < spinCount && work == nullptr; ++i)
+    {
+      delay.pause ();
 
-    jassert (work != nullptr);
+      work = m_group.findWork (this);
+    }
+  }
 
-    work->operator() (this);
+  while (work == nullptr && !m_group.m_stop.isSignaled ())
+  {
+    // Announce that we are going to sleep, then look one last time.
+    // A producer that pushes after this point will see the count
+    // and signal the semaphore, so the wakeup cannot be lost.
+    //
+    ++(*m_group.m_parked);
+
+    work = m_group.findWork (this);
+
+    if (work != nullptr)
+    {
+      // If a producer already claimed our slot, then it also signaled
+      // the semaphore. Consume the signal to keep the count balanced.
+      //
+      if (!m_group.tryUnpark ())
+        m_group.m_semaphore.wait ();
+    }
+    else
+    {
+      m_group.m_semaphore.wait ();
+
+      work = m_group.findWork (this);
+    }
+  }
+
+  return work;
+}
+
+void ThreadGroup::Worker::run ()
+{
+  for (;;)
+  {
+    Work* const work = waitForWork ();
+
+    if (work == nullptr)
+      break;
+
+    work->operator() ();
 
     delete work;
   }
-  while (!m_shouldExit);
 }
 
 //==============================================================================
@@ -78,41 +202,119 @@ void ThreadGroup::Worker::run ()
 ThreadGroup::ThreadGroup (int numberOfThreads)
   : m_numberOfThreads (numberOfThreads)
   , m_semaphore (0)
+  , m_workers (numberOfThreads)
+  , m_nextWorker (0)
+  , m_parked (0)
 {
-  for (int i = 0; i++ < numberOfThreads; )
+  // All the workers must exist before any of them can steal.
+  for (int i = 0; i < numberOfThreads; ++i)
   {
     String s;
-    s << "ThreadGroup (" << i << ")";
+    s << "ThreadGroup (" << (i + 1) << ")";
 
-    m_threads.push_front (new Worker (s, *this));
+    m_workers [i] = new Worker (s, i, *this);
   }
+
+  for (int i = 0; i < numberOfThreads; ++i)
+    m_workers [i]->startThread ();
 }
 
 ThreadGroup::~ThreadGroup ()
 {
-  // Put one quit item in the queue for each worker to stop.
+  // Tell the workers to exit once all the work is done, and
+  // wake up any that are sleeping.
+  //
+  m_stop.signal ();
+
+  m_semaphore.signal (m_numberOfThreads);
+
+  // Wait for every worker to exit before deleting any of them,
+  // since a running worker can still try to steal from the others.
+  //
   for (int i = 0; i < m_numberOfThreads; ++i)
+    m_workers [i]->waitForThreadToExit (-1);
+
+  for (int i = 0; i < m_numberOfThreads; ++i)
+    delete m_workers [i];
+}
+
+int ThreadGroup::getNumberOfThreads () const
+{
+  return m_numberOfThreads;
+}
+
+// Work from a thread in the group goes on its own deque. Work from
+// any other thread is spread among the inboxes in round-robin order.
+//
+void ThreadGroup::schedule (Work* work)
+{
+  Worker* const worker = getCurrentWorker ();
+
+  if (worker != nullptr)
+  {
+    worker->push (work);
+  }
+  else
   {
-    m_queue.push_front (new (getAllocator ()) QuitType);
+    int const index = (++m_nextWorker & 0x7fffffff) % m_numberOfThreads;
 
-    m_semaphore.signal ();
+    m_workers [index]->post (work);
   }
 
-  for (;;)
+  if (tryUnpark ())
+    m_semaphore.signal ();
+}
+
+// Look on our own deque and inbox first, then try to steal from the others.
+//
+ThreadGroup::Work* ThreadGroup::findWork (Worker* worker)
+{
+  Work* work = worker->popBack ();
+
+  if (work == nullptr)
+    work = worker->adopt (worker->popInbox ());
+
+  if (work == nullptr)
   {
-    Worker* worker = m_threads.pop_front ();
+    int const first = worker->getIndex ();
 
-    if (worker != nullptr)
-      delete worker;
-    else
-      break;
+    for (int i = 1; i < m_numberOfThreads; ++i)
+    {
+      Worker* const victim = m_workers [(first + i) % m_numberOfThreads];
+
+      work = victim->popFront ();
+
+      if (work == nullptr)
+        work = worker->adopt (victim->popInbox ());
+
+      if (work != nullptr)
+        break;
+    }
   }
 
-  // There must not be pending work!
-  jassert (m_queue.pop_front () == nullptr);
+  return work;
 }
 
-int ThreadGroup::getNumberOfThreads () const
+ThreadGroup::Worker* ThreadGroup::getCurrentWorker ()
 {
-  return m_numberOfThreads;
+  Worker* const worker = dynamic_cast <Worker*> (Thread::getCurrentThread ());
+
+  return (worker != nullptr && &worker->getGroup () == this) ? worker : nullptr;
+}
+
+// Claim one sleeping worker, if there are any. Whoever succeeds
+// is responsible for a matching signal or wait on the semaphore.
+//
+bool ThreadGroup::tryUnpark ()
+{
+  for (;;)
+  {
+    int const parked = m_parked->get ();
+
+    if (parked <= 0)
+      return false;
+
+    if (m_parked->compareAndSetBool (parked - 1, parked))
+      return true;
+  }
 }
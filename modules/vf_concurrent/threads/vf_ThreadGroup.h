@@ -39,6 +39,32 @@
 
   @brief A group of threads for parallelizing tasks.
 
+  Work is scheduled using work stealing. Each thread in the group owns a
+  private deque of work items. Work submitted from a thread in the group goes
+  on that thread's own deque, while work submitted from outside the group is
+  posted to a lock-free inbox on one of the threads in round-robin order.
+  A thread takes work from the back of its own deque (LIFO), which keeps
+  recently touched data in the cache. When its deque is empty, it moves its
+  whole inbox onto the deque with a single atomic exchange. After that it
+  steals from the front of another thread's deque (FIFO), taking the oldest
+  and usually largest piece of work, or else takes over the other thread's
+  inbox.
+
+  A thread which finds no work spins briefly. It then increments a shared
+  count of parked threads, looks for work one last time, and sleeps on the
+  semaphore. Every submission tries to claim one parked thread by
+  decrementing that count with a compare-and-swap. Only a successful claim
+  signals the semaphore, so under load the count stays at zero and
+  submitting costs one read of it instead of a system call.
+
+  A submission from a thread in the group takes the lock on its own deque,
+  which is almost never contended. A submission from outside the group also
+  increments the shared round-robin counter, then pushes onto the chosen
+  thread's inbox with a compare-and-swap, and takes no lock.
+
+  When the group is destroyed, all pending work is executed before the
+  threads exit.
+
   @see ParallelFor
 */
 class ThreadGroup
@@ -90,10 +116,7 @@ public:
       numberOfThreads = maxThreads;
 
     while (numberOfThreads--)
-    {
-      m_queue.push_front (new (getAllocator ()) WorkType <Functor> (f));
-      m_semaphore.signal ();
-    }
+      schedule (new (getAllocator ()) WorkType <Functor> (f));
   }
 
   template <class Fn>
@@ -134,45 +157,53 @@ public:
 
   /** @} */
 
-private:
-  void stopThreads (int numberOfThreadsToStop);
+  /** Calls a cancellable functor on multiple threads.
 
-  //============================================================================
-private:
-  /** A thread in the group.
+      If the token is cancelled before a thread takes the functor from its
+      queue, that thread skips it.
+
+      @param maxThreads The maximum number of threads to use, or -1 for all.
+
+      @param token      The token which can cancel the call. It must outlive
+                        the call.
+
+      @param f          The functor to call for each thread.
+
+      @see CancellationToken
   */
-  class Worker
-    : public LockFreeStack <Worker>::Node
-    , public Thread
-    , LeakChecked <Worker>
+  template <class Functor>
+  void callf (int maxThreads, CancellationToken const& token, Functor f)
   {
-  public:
-    Worker (String name, ThreadGroup& group);
-    ~Worker ();
+    callf (maxThreads, CancellableFunctor <Functor> (token, f));
+  }
 
-    void setShouldExit ();
+private:
+  class Work;
+  class Worker;
 
-  private:
-    void run ();
+  void schedule (Work* work);
+  Work* findWork (Worker* worker);
+  Worker* getCurrentWorker ();
+  bool tryUnpark ();
 
-  private:
-    ThreadGroup& m_group;
-    bool m_shouldExit;
+  enum
+  {
+    /** Number of times an idle thread looks for work before sleeping. */
+    spinCount = 64
   };
 
   //============================================================================
 private:
   /** Abstract work item.
   */
-  class Work : public LockFreeStack <Work>::Node
+  class Work : public List <Work>::Node
+             , public LockFreeStack <Work>::Node
              , public AllocatedBy <AllocatorType>
   {
   public:
     virtual ~Work () { }
 
-    /* The worker is passed in so we can make it quit later.
-    */
-    virtual void operator() (Worker* worker) = 0;
+    virtual void operator() () = 0;
   };
 
   template <class Functor>
@@ -181,28 +212,85 @@ private:
   public:
     explicit WorkType (Functor const& f) : m_f (f) { }
     ~WorkType () { }
-    void operator() (Worker*) { m_f (); }
+    void operator() () { m_f (); }
+
+  private:
+    Functor m_f;
+  };
+
+  template <class Functor>
+  class CancellableFunctor
+  {
+  public:
+    CancellableFunctor (CancellationToken const& token, Functor const& f)
+      : m_token (&token)
+      , m_f (f)
+    {
+    }
+
+    void operator() ()
+    {
+      if (! m_token->isCancelled ())
+        m_f ();
+    }
 
   private:
+    CancellationToken const* m_token;
     Functor m_f;
   };
 
-  /** Used to make a Worker stop
+  //============================================================================
+private:
+  /** A thread in the group.
+
+      Each worker owns a deque of work. The owner pushes and pops at the
+      back, while other workers steal from the front. The lock protecting
+      the deque is almost never contended.
+
+      Threads outside the group post to the inbox instead, which needs no
+      lock. The inbox is emptied in one atomic operation and the batch is
+      moved onto the deque of the worker that took it.
   */
-  class QuitType
-    : public Work
-    , LeakChecked <QuitType>
+  class Worker
+    : public Thread
+    , LeakChecked <Worker>
   {
   public:
-    void operator() (Worker* worker);
+    Worker (String name, int index, ThreadGroup& group);
+    ~Worker ();
+
+    int getIndex () const { return m_index; }
+    ThreadGroup& getGroup () const { return m_group; }
+
+    void push (Work* work);
+    void post (Work* work);
+    Work* popBack ();
+    Work* popFront ();
+    LockFreeStack <Work>::Chain popInbox ();
+    Work* adopt (LockFreeStack <Work>::Chain chain);
+
+  private:
+    Work* waitForWork ();
+    void run ();
+
+  private:
+    typedef SpinLock LockType;
+
+    ThreadGroup& m_group;
+    int const m_index;
+    LockType m_mutex;
+    List <Work> m_deque;
+    LockFreeStack <Work> m_inbox;
   };
 
 private:
   int const m_numberOfThreads;
   Semaphore m_semaphore;
   AllocatorType m_allocator;
-  LockFreeStack <Work> m_queue;
-  LockFreeStack <Worker> m_threads;
+  HeapBlock <Worker*> m_workers;
+  Atomic <int> m_nextWorker;
+  AtomicFlag m_stop;
+  CacheLine::Padded <Atomic <int> > m_parked;
 };
 
 #endif
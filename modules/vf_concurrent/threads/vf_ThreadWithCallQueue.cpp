@@ -36,6 +36,8 @@ ThreadWithCallQueue::ThreadWithCallQueue (String name)
   , m_calledStart (false)
   , m_calledStop (false)
   , m_shouldStop (false)
+  , m_adaptiveSpin (1)
+  , m_averageIdle (0)
 {
 }
 
@@ -117,6 +119,15 @@ void ThreadWithCallQueue::interrupt ()
   call (Function <void (void)>::None ());
 }
 
+void ThreadWithCallQueue::setIdleSpin (int maximumMicroseconds, bool adaptive)
+{
+  jassert (maximumMicroseconds >= 0);
+
+  m_adaptiveSpin.set (adaptive ? 1 : 0);
+  m_maximumSpin.set (maximumMicroseconds);
+  m_spinWindow.set (maximumMicroseconds);
+}
+
 void ThreadWithCallQueue::signal ()
 {
   m_thread.interrupt ();
@@ -149,8 +160,75 @@ void ThreadWithCallQueue::run ()
       interrupted = interruptionPoint ();
 
     if (!interrupted)
-      m_thread.wait ();
+    {
+      int64 const idleStart = Time::getHighResolutionTicks ();
+
+      if (spin (m_spinWindow.get ()))
+      {
+        ++m_numberOfSpinHits;
+      }
+      else
+      {
+        ++m_numberOfParks;
+
+        m_thread.wait ();
+      }
+
+      updateSpinWindow (Time::getHighResolutionTicks () - idleStart);
+    }
   }
 
   m_exit ();
 }
+
+// Poll for an interruption until the window expires. While the thread
+// is polling it is not in the wait state, so signal() only flips the
+// interruption state and never has to wake the thread through the kernel.
+//
+bool ThreadWithCallQueue::spin (int microseconds)
+{
+  bool interrupted = false;
+
+  if (microseconds > 0)
+  {
+    int64 const deadline = Time::getHighResolutionTicks () +
+      (microseconds * Time::getHighResolutionTicksPerSecond ()) / 1000000;
+
+    SpinDelay delay;
+
+    for (;;)
+    {
+      interrupted = m_thread.interruptionPoint ();
+
+      if (interrupted || Time::getHighResolutionTicks () >= deadline)
+        break;
+
+      delay.pause ();
+    }
+  }
+
+  return interrupted;
+}
+
+// Track a moving average of the idle periods and spin for twice that,
+// so most arrivals land inside the window. The window is capped at the
+// maximum, and only drops to zero when the average itself is beyond the
+// maximum. Idle periods which end in a sleep count too, otherwise the
+// window could never grow again.
+//
+void ThreadWithCallQueue::updateSpinWindow (int64 idleTicks)
+{
+  int const maximumSpin = m_maximumSpin.get ();
+
+  if (maximumSpin > 0 && m_adaptiveSpin.get () != 0)
+  {
+    int64 const idle = (idleTicks * 1000000) / Time::getHighResolutionTicksPerSecond ();
+
+    m_averageIdle = (m_averageIdle * 7 + idle) / 8;
+
+    if (m_averageIdle > maximumSpin)
+      m_spinWindow.set (0);
+    else
+      m_spinWindow.set (int (jmin (m_averageIdle * 2, int64 (maximumSpin))));
+  }
+}
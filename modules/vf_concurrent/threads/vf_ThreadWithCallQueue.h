@@ -127,12 +127,50 @@ public:
   */
   void interrupt ();
 
+  /** Spin for a while before sleeping when there is no work.
+
+      When the queue runs out of functors the thread normally goes straight
+      to sleep, and every new functor then pays for a kernel wakeup. For
+      request/response traffic between two threads this latency dominates.
+      With a spin window the thread first polls for new work with a backoff,
+      and only sleeps when nothing arrives within the window.
+
+      If `adaptive` is true, the window follows twice the average time
+      between the thread going idle and new work arriving, up to the
+      maximum. When work usually arrives later than the maximum, the window
+      shrinks to zero so the thread stops burning cycles for nothing.
+
+      This may be called from any thread at any time.
+
+      @param maximumMicroseconds The longest time to spin, or 0 to always
+                                 sleep immediately. This is the default.
+
+      @param adaptive            `true` to tune the window from observed
+                                 arrival times, or `false` to always spin
+                                 for the maximum.
+  */
+  void setIdleSpin (int maximumMicroseconds, bool adaptive = true);
+
+  /** Determine the number of times work arrived while spinning.
+  */
+  int getNumberOfSpinHits () const { return m_numberOfSpinHits.get (); }
+
+  /** Determine the number of times the thread went to sleep.
+  */
+  int getNumberOfParks () const { return m_numberOfParks.get (); }
+
+  /** Determine the current spin window in microseconds.
+  */
+  int getSpinWindow () const { return m_spinWindow.get (); }
+
 private:
   void signal ();
   void reset ();
 
   void do_stop ();
   void run ();
+  bool spin (int microseconds);
+  void updateSpinWindow (int64 idleTicks);
 
 private:
   InterruptibleThread m_thread;
@@ -143,6 +181,12 @@ private:
   idle_t m_idle;
   init_t m_init;
   exit_t m_exit;
+  Atomic <int> m_maximumSpin;
+  Atomic <int> m_adaptiveSpin;
+  Atomic <int> m_spinWindow;
+  Atomic <int> m_numberOfSpinHits;
+  Atomic <int> m_numberOfParks;
+  int64 m_averageIdle;
 };
 
 #endif
@@ -0,0 +1,92 @@
+/*============================================================================*/
+/*
+  VFLib: https://github.com/vinniefalco/VFLib
+
+  Copyright (C) 2008 by Vinnie Falco <vinnie.falco@gmail.com>
+
+  This library contains portions of other open source products covered by
+  separate licenses. Please see the corresponding source files for specific
+  terms.
+  
+  VFLib is provided under the terms of The MIT License (MIT):
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+  IN THE SOFTWARE.
+*/
+/*============================================================================*/
+
+TimedCall::TimedCall (CallQueue& queue)
+  : m_queue (queue)
+  , m_timer (this)
+  , m_periodic (false)
+{
+}
+
+TimedCall::~TimedCall ()
+{
+}
+
+// While the timer is scheduled, we hold a reference to ourselves
+// so that a discarded handle doesn't cancel the call.
+//
+void TimedCall::start (int delayMilliseconds, int periodMilliseconds)
+{
+  m_periodic = periodMilliseconds != 0;
+
+  incReferenceCount ();
+
+  m_timer.startTimer (delayMilliseconds, periodMilliseconds);
+}
+
+void TimedCall::cancel ()
+{
+  m_token.cancel ();
+
+  // If the timer was still scheduled, it will never fire again,
+  // so give up the reference it was holding.
+  //
+  if (m_timer.stopTimer ())
+    decReferenceCount ();
+}
+
+// Called on the timer thread.
+//
+void TimedCall::fire ()
+{
+  if (! m_token.isCancelled () && m_queued.trySignal ())
+  {
+    if (! m_queue.queuep (new (m_queue.getAllocator ()) Work (this)))
+      m_queued.reset ();
+  }
+
+  // A one-shot timer is finished. The work holds its own reference, and the
+  // wheel won't touch the timer again, so this may delete us.
+  //
+  if (! m_periodic)
+    decReferenceCount ();
+}
+
+// Called on the queue's thread.
+//
+void TimedCall::execute ()
+{
+  m_queued.reset ();
+
+  if (! m_token.isCancelled ())
+    call ();
+}
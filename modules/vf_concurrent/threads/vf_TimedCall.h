@@ -0,0 +1,204 @@
+/*============================================================================*/
+/*
+  VFLib: https://github.com/vinniefalco/VFLib
+
+  Copyright (C) 2008 by Vinnie Falco <vinnie.falco@gmail.com>
+
+  This library contains portions of other open source products covered by
+  separate licenses. Please see the corresponding source files for specific
+  terms.
+  
+  VFLib is provided under the terms of The MIT License (MIT):
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+  IN THE SOFTWARE.
+*/
+/*============================================================================*/
+
+#ifndef VF_TIMEDCALL_VFHEADER
+#define VF_TIMEDCALL_VFHEADER
+
+/*============================================================================*/
+/**
+  A delayed or periodic call into a CallQueue.
+
+  Use callAfter() or callEvery() to create one. The TimerWheel thread queues
+  the functor when its time comes, and the functor then runs on the thread
+  associated with the CallQueue, like any other call:
+
+  @code
+
+  TimedCall::Ptr autosave = callEvery (guiQueue, 60000,
+    vf::bind (&Document::save, document));
+
+  //...
+
+  autosave->cancel ();
+
+  @endcode
+
+  A pending call stays alive even if the returned handle is discarded. It is
+  an error to close the CallQueue while a periodic call is still scheduled.
+
+  If a periodic call comes due while the previous call is still waiting in
+  the queue, it is skipped, so a slow consumer never builds up a backlog of
+  timer calls. The functor is queued from the timer thread, so a queue with
+  the CallQueue::overflowBlock policy should not be used, since a full
+  queue would stall every timer.
+
+  @see TimerWheel
+
+  @ingroup vf_concurrent
+*/
+class TimedCall
+  : public ReferenceCountedObject
+  , public AllocatedBy <CallQueue::AllocatorType>
+  , Uncopyable
+{
+public:
+  typedef ReferenceCountedObjectPtr <TimedCall> Ptr;
+
+  /** Cancel the call.
+
+      This takes constant time. If the functor was already queued, it is
+      skipped when the queue is synchronized.
+  */
+  void cancel ();
+
+  /** Determine if the call was cancelled.
+  */
+  bool isCancelled () const { return m_token.isCancelled (); }
+
+protected:
+  explicit TimedCall (CallQueue& queue);
+
+  ~TimedCall ();
+
+  /** Called on the queue's thread. */
+  virtual void call () = 0;
+
+  void start (int delayMilliseconds, int periodMilliseconds);
+
+  template <class Functor>
+  friend TimedCall::Ptr callAfter (CallQueue&, int, Functor const&);
+
+  template <class Functor>
+  friend TimedCall::Ptr callEvery (CallQueue&, int, Functor const&);
+
+private:
+  class Timer : public TimerWheel::Timer
+  {
+  public:
+    explicit Timer (TimedCall* owner) : m_owner (owner) { }
+    ~Timer () { stopTimer (); }
+
+  private:
+    void onTimer () { m_owner->fire (); }
+
+    TimedCall* const m_owner;
+  };
+
+  class Work : public CallQueue::Work
+  {
+  public:
+    explicit Work (TimedCall* owner) : m_owner (owner) { }
+    void operator() () { m_owner->execute (); }
+    bool canDiscard () const { return false; }
+
+  private:
+    Ptr m_owner;
+  };
+
+  void fire ();
+  void execute ();
+
+private:
+  CallQueue& m_queue;
+  Timer m_timer;
+  bool m_periodic;
+  AtomicFlag m_queued;
+  CancellationToken m_token;
+};
+
+//------------------------------------------------------------------------------
+
+template <class Functor>
+class TimedCallType : public TimedCall
+{
+public:
+  TimedCallType (CallQueue& queue, Functor const& f)
+    : TimedCall (queue)
+    , m_f (f)
+  {
+  }
+
+private:
+  void call () { m_f (); }
+
+  Functor m_f;
+};
+
+//------------------------------------------------------------------------------
+
+/** Call a functor in a CallQueue after a delay.
+
+    @param queue             The queue to call the functor in.
+
+    @param delayMilliseconds The time to wait.
+
+    @param f                 The functor to call, typically the return value
+                             of a call to bind().
+
+    @return A handle which can be used to cancel the call.
+*/
+template <class Functor>
+TimedCall::Ptr callAfter (CallQueue& queue, int delayMilliseconds, Functor const& f)
+{
+  TimedCall::Ptr timedCall (new (queue.getAllocator ()) TimedCallType <Functor> (queue, f));
+
+  timedCall->start (delayMilliseconds, 0);
+
+  return timedCall;
+}
+
+/** Call a functor in a CallQueue periodically.
+
+    The first call happens one period from now.
+
+    @param queue              The queue to call the functor in.
+
+    @param periodMilliseconds The time between calls.
+
+    @param f                  The functor to call, typically the return value
+                              of a call to bind().
+
+    @return A handle which can be used to cancel the calls.
+*/
+template <class Functor>
+TimedCall::Ptr callEvery (CallQueue& queue, int periodMilliseconds, Functor const& f)
+{
+  jassert (periodMilliseconds > 0);
+
+  TimedCall::Ptr timedCall (new (queue.getAllocator ()) TimedCallType <Functor> (queue, f));
+
+  timedCall->start (periodMilliseconds, periodMilliseconds);
+
+  return timedCall;
+}
+
+#endif
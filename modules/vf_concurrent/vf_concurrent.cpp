@@ -47,7 +47,7 @@
 
 namespace vf
 {
-#if VF_USE_BOOST
+#if VF_USE_BOOST || VF_USE_NATIVE_TLS
 #include "memory/vf_FifoFreeStoreWithTLS.cpp"
 #else
 #include "memory/vf_FifoFreeStoreWithoutTLS.cpp"
@@ -55,13 +55,17 @@ namespace vf
 #include "memory/vf_GlobalPagedFreeStore.cpp"
 #include "memory/vf_PagedFreeStore.cpp"
 
+#include "threads/vf_BoundedCallQueue.cpp"
 #include "threads/vf_CallQueue.cpp"
 #include "threads/vf_ConcurrentObject.cpp"
+#include "threads/vf_DistributedReadWriteMutex.cpp"
 #include "threads/vf_Listeners.cpp"
 #include "threads/vf_ManualCallQueue.cpp"
 #include "threads/vf_MessageThread.cpp"
 #include "threads/vf_ParallelFor.cpp"
 #include "threads/vf_ReadWriteMutex.cpp"
+#include "threads/vf_TaskGraph.cpp"
+#include "threads/vf_TimedCall.cpp"
 #include "threads/vf_ThreadGroup.cpp"
 #include "threads/vf_ThreadWithCallQueue.cpp"
 
@@ -144,23 +144,56 @@
 
 #include "modules/juce_gui_basics/juce_gui_basics.h"
 
+/* Use C++20 coroutines when the compiler supports them.
+*/
+#ifndef VF_USE_COROUTINES
+# if defined (__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+#  define VF_USE_COROUTINES 1
+# else
+#  define VF_USE_COROUTINES 0
+# endif
+#endif
+
+#if VF_USE_COROUTINES
+#include <coroutine>
+#endif
+
+/* Use the compiler's thread local storage for FifoFreeStoreWithTLS
+   and MagazineFreeStore.
+*/
+#ifndef VF_USE_NATIVE_TLS
+# if JUCE_LINUX && (defined (__GNUC__) || defined (__clang__))
+#  define VF_USE_NATIVE_TLS 1
+# else
+#  define VF_USE_NATIVE_TLS 0
+# endif
+#endif
+
+#if VF_USE_NATIVE_TLS
+#include <pthread.h>
+#endif
+
 namespace vf
 {
 
 #include "memory/vf_AllocatedBy.h"
 #include "memory/vf_FifoFreeStore.h"
-#if VF_USE_BOOST
+#if VF_USE_BOOST || VF_USE_NATIVE_TLS
 #include "memory/vf_FifoFreeStoreWithTLS.h"
 #else
 #include "memory/vf_FifoFreeStoreWithoutTLS.h"
 #endif
 #include "memory/vf_GlobalFifoFreeStore.h"
 #include "memory/vf_GlobalPagedFreeStore.h"
+#include "memory/vf_MagazineFreeStore.h"
 #include "memory/vf_PagedFreeStore.h"
 
+#include "threads/vf_CancellationToken.h"
 #include "threads/vf_ReadWriteMutex.h"
+#include "threads/vf_DistributedReadWriteMutex.h"
 #include "threads/vf_ThreadGroup.h"
 
+#include "threads/vf_BoundedCallQueue.h"
 #include "threads/vf_CallQueue.h"
 #include "threads/vf_ConcurrentObject.h"
 #include "threads/vf_ConcurrentState.h"
@@ -168,11 +201,19 @@ namespace vf
 #include "threads/vf_Listeners.h"
 #include "threads/vf_ManualCallQueue.h"
 #include "threads/vf_ParallelFor.h"
+#include "threads/vf_SeqLockState.h"
+#include "threads/vf_SnapshotState.h"
+#include "threads/vf_TaskGraph.h"
+#include "threads/vf_TimedCall.h"
 #include "threads/vf_ThreadWithCallQueue.h"
 
 #include "threads/vf_GuiCallQueue.h"
 
 #include "threads/vf_MessageThread.h"
+
+#if VF_USE_COROUTINES
+#include "threads/vf_Coroutine.h"
+#endif
 }
 
 #endif
@@ -0,0 +1,234 @@
+/*============================================================================*/
+/*
+  VFLib: https://github.com/vinniefalco/VFLib
+
+  Copyright (C) 2008 by Vinnie Falco <vinnie.falco@gmail.com>
+
+  This library contains portions of other open source products covered by
+  separate licenses. Please see the corresponding source files for specific
+  terms.
+  
+  VFLib is provided under the terms of The MIT License (MIT):
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+  IN THE SOFTWARE.
+*/
+/*============================================================================*/
+
+#ifndef VF_BOUNDEDLOCKFREEQUEUE_VFHEADER
+#define VF_BOUNDEDLOCKFREEQUEUE_VFHEADER
+
+#include "../memory/vf_CacheLine.h"
+
+/*============================================================================*/
+/** 
+  Multiple Producer, Multiple Consumer (MPMC) bounded FIFO.
+
+  This is a fixed size array of cells, each with its own sequence number,
+  after the design by Dmitry Vyukov. A producer claims the next cell by
+  advancing the enqueue position with a compare-and-swap, fills it, and then
+  publishes it through the cell's sequence number. Consumers do the same on
+  the dequeue position. Storage is allocated once, in the constructor, and
+  elements are stored by value, so pushing and popping never allocates.
+
+  Unlike LockFreeQueue, a consumer never waits for a producer that is in the
+  middle of a push. If the cell at the front has been claimed but not yet
+  published, the pop reports that the queue is empty.
+
+  Elements can be copied in and out, or constructed and used in place
+  through acquirePush() / commitPush() and acquirePop() / commitPop().
+
+  @param Element The type of element. It must be default constructible.
+
+  @see LockFreeQueue, LockFreeRingBuffer
+
+  @ingroup vf_core
+*/
+template <class Element>
+class BoundedLockFreeQueue : Uncopyable
+{
+public:
+  /** Create a queue.
+
+      @param capacity The minimum number of elements the queue can hold. It is
+                      rounded up to a power of two.
+  */
+  explicit BoundedLockFreeQueue (int capacity)
+  {
+    jassert (capacity > 0 && capacity <= (1 << 30));
+
+    int size = 2;
+    while (size < capacity)
+      size *= 2;
+
+    m_mask = uint32 (size - 1);
+    m_cells = new Cell [size];
+
+    for (int i = 0; i < size; ++i)
+      m_cells [i].m_sequence.set (uint32 (i));
+
+    m_enqueuePosition->set (0);
+    m_dequeuePosition->set (0);
+  }
+
+  ~BoundedLockFreeQueue ()
+  {
+    delete [] m_cells;
+  }
+
+  /** Determine the number of elements the queue can hold. */
+  int getCapacity () const noexcept
+  {
+    return int (m_mask + 1);
+  }
+
+  /** Add an element.
+
+      @return `false` if the queue was full.
+  */
+  bool push_back (Element const& element)
+  {
+    Element* const cell = acquirePush ();
+
+    if (cell != nullptr)
+    {
+      *cell = element;
+      commitPush (cell);
+    }
+
+    return cell != nullptr;
+  }
+
+  /** Remove an element.
+
+      @param[out] element Receives the element.
+
+      @return `false` if the queue was empty.
+  */
+  bool pop_front (Element* element)
+  {
+    Element* const cell = acquirePop ();
+
+    if (cell != nullptr)
+    {
+      *element = *cell;
+      commitPop (cell);
+    }
+
+    return cell != nullptr;
+  }
+
+  /** Claim a cell at the back of the queue.
+
+      The caller fills in the element and then calls commitPush(). Consumers
+      do not see the element until then.
+
+      @return The element to fill in, or nullptr if the queue was full.
+  */
+  Element* acquirePush () noexcept
+  {
+    uint32 position = m_enqueuePosition->get ();
+
+    for (;;)
+    {
+      Cell& cell = m_cells [position & m_mask];
+      int const difference = int (cell.m_sequence.get () - position);
+
+      if (difference == 0)
+      {
+        if (m_enqueuePosition->compareAndSetBool (position + 1, position))
+          return &cell.m_element;
+      }
+      else if (difference < 0)
+      {
+        return nullptr;
+      }
+
+      position = m_enqueuePosition->get ();
+    }
+  }
+
+  /** Publish an element obtained from acquirePush().
+  */
+  void commitPush (Element* element) noexcept
+  {
+    Cell& cell = toCell (element);
+
+    cell.m_sequence.set (uint32 (cell.m_sequence.get () + 1));
+  }
+
+  /** Claim the element at the front of the queue.
+
+      The caller uses the element in place and then calls commitPop() to
+      give the cell back to producers.
+
+      @return The element, or nullptr if the queue was empty or the front
+              element has not been published yet.
+  */
+  Element* acquirePop () noexcept
+  {
+    uint32 position = m_dequeuePosition->get ();
+
+    for (;;)
+    {
+      Cell& cell = m_cells [position & m_mask];
+      int const difference = int (cell.m_sequence.get () - (position + 1));
+
+      if (difference == 0)
+      {
+        if (m_dequeuePosition->compareAndSetBool (position + 1, position))
+          return &cell.m_element;
+      }
+      else if (difference < 0)
+      {
+        return nullptr;
+      }
+
+      position = m_dequeuePosition->get ();
+    }
+  }
+
+  /** Release an element obtained from acquirePop().
+  */
+  void commitPop (Element* element) noexcept
+  {
+    Cell& cell = toCell (element);
+
+    // The cell becomes free for the producer one lap later.
+    cell.m_sequence.set (uint32 (cell.m_sequence.get () + m_mask));
+  }
+
+private:
+  struct Cell
+  {
+    Element m_element;            // must come first, see toCell()
+    Atomic <uint32> m_sequence;
+  };
+
+  static Cell& toCell (Element* element) noexcept
+  {
+    return *reinterpret_cast <Cell*> (element);
+  }
+
+  uint32 m_mask;
+  Cell* m_cells;
+  CacheLine::Aligned <Atomic <uint32> > m_enqueuePosition;
+  CacheLine::Aligned <Atomic <uint32> > m_dequeuePosition;
+};
+
+#endif
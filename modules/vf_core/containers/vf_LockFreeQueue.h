@@ -74,6 +74,56 @@ public:
     AtomicPointer <Node> m_next;
   };
 
+  /** A chain of elements detached from a queue.
+
+      The chain belongs to the consumer, so taking elements from it needs
+      no synchronization.
+
+      @see detach
+  */
+  class Chain
+  {
+  public:
+    Chain () : m_head (nullptr)
+    {
+    }
+
+    /** Determine if the chain is empty. */
+    bool empty () const
+    {
+      return m_head == nullptr;
+    }
+
+    /** Take the oldest element off the chain.
+
+        @return The element, or nullptr if the chain was empty.
+    */
+    Element* pop_front ()
+    {
+      Node* const node = m_head;
+
+      if (node != nullptr)
+        m_head = node->m_next.get ();
+
+      return static_cast <Element*> (node);
+    }
+
+    /** Put an element on the front of the chain.
+
+        This is used to put back an element taken with pop_front().
+    */
+    void push_front (Node* node)
+    {
+      node->m_next.set (m_head);
+      m_head = node;
+    }
+
+  private:
+    friend class LockFreeQueue;
+
+    Node* m_head;
+  };
+
 public:
   /** Create an empty list.
   */
@@ -220,6 +270,63 @@ public:
     }
   }
 
+  /** Detach a batch of elements.
+
+      This takes every element which is completely linked into the list,
+      except the newest one, and hands them back as a chain in FIFO order.
+      No atomic read-modify-write operations are needed, and the consumer
+      never waits for a push_back() that is in progress; it just stops
+      there. Elements left behind are retrieved by a later call to detach()
+      or pop_front().
+
+      Only the consumer may call this.
+
+      @return The detached elements, oldest first.
+  */
+  Chain detach ()
+  {
+    Chain chain;
+    Node* last = nullptr;
+    Node* tail = m_tail;
+    Node* next = tail->m_next.get ();
+
+    for (;;)
+    {
+      if (tail == &m_null)
+      {
+        // Step over the stub, wherever it is in the list.
+        if (next == 0)
+          break;
+
+        m_tail = next;
+        tail = next;
+        next = next->m_next.get ();
+      }
+
+      // Only a node with a successor can be taken without racing a
+      // push_back(). The newest node stays behind.
+      if (next == 0)
+        break;
+
+      if (last != nullptr)
+        last->m_next.set (tail);
+      else
+        chain.m_head = tail;
+
+      last = tail;
+
+      m_tail = next;
+      tail = next;
+      next = next->m_next.get ();
+    }
+
+    // The last node belongs to us now, so end the chain there.
+    if (last != nullptr)
+      last->m_next.set (0);
+
+    return chain;
+  }
+
 private:
   // Elements are pushed on to the head and popped from the tail.
   AtomicPointer <Node> m_head;
@@ -0,0 +1,348 @@
+/*============================================================================*/
+/*
+  VFLib: https://github.com/vinniefalco/VFLib
+
+  Copyright (C) 2008 by Vinnie Falco <vinnie.falco@gmail.com>
+
+  This library contains portions of other open source products covered by
+  separate licenses. Please see the corresponding source files for specific
+  terms.
+  
+  VFLib is provided under the terms of The MIT License (MIT):
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+  IN THE SOFTWARE.
+*/
+/*============================================================================*/
+
+#ifndef VF_LOCKFREERINGBUFFER_VFHEADER
+#define VF_LOCKFREERINGBUFFER_VFHEADER
+
+#include "../memory/vf_CacheLine.h"
+
+/*============================================================================*/
+/** 
+  Single Producer, Single Consumer (SPSC) bounded FIFO.
+
+  This is a fixed size ring of trivially copyable elements, for streaming
+  samples or events between two threads without allocating. Storage is
+  allocated once, in the constructor. Both sides are wait-free.
+
+  The producer owns the write index and the consumer owns the read index,
+  and each index lives on its own cache line together with the owner's
+  cached copy of the other index. A side only looks at the other side's
+  index when its cached copy says the ring is full or empty, so in steady
+  state the two threads rarely touch each other's cache lines.
+
+  Invariants:
+
+  - Only one thread may call the producer functions at a time: push_back(),
+    write(), acquireWrite() and commitWrite().
+
+  - Only one thread may call the consumer functions at a time: pop_front(),
+    read(), acquireRead() and commitRead().
+
+  Elements can be copied in and out, or accessed in place:
+
+  @code
+
+  LockFreeRingBuffer <float> ring (4096);
+
+  void producer (float const* samples, int count)
+  {
+    float* dest;
+    int const available = ring.acquireWrite (&dest, count);
+
+    memcpy (dest, samples, available * sizeof (float));
+
+    ring.commitWrite (available);
+  }
+
+  @endcode
+
+  @param Element The type of element. It must be trivially copyable, since
+                 elements are moved with memcpy().
+
+  @see LockFreeQueue
+
+  @ingroup vf_core
+*/
+template <class Element>
+class LockFreeRingBuffer : Uncopyable
+{
+public:
+  /** Create a ring buffer.
+
+      @param capacity The minimum number of elements the ring can hold. It is
+                      rounded up to a power of two.
+  */
+  explicit LockFreeRingBuffer (int capacity)
+  {
+    jassert (capacity > 0 && capacity <= (1 << 30));
+
+    int size = 1;
+    while (size < capacity)
+      size *= 2;
+
+    m_mask = uint32 (size - 1);
+    m_elements.malloc (size_t (size));
+
+    m_writer->m_index.set (0);
+    m_writer->m_position = 0;
+    m_writer->m_cachedIndex = 0;
+    m_reader->m_index.set (0);
+    m_reader->m_position = 0;
+    m_reader->m_cachedIndex = 0;
+  }
+
+  /** Determine the number of elements the ring can hold. */
+  int getCapacity () const noexcept
+  {
+    return int (m_mask + 1);
+  }
+
+  /** Determine the number of elements in the ring.
+
+      The value may be out of date as soon as it is returned.
+  */
+  int size () const noexcept
+  {
+    return int (load (m_writer->m_index) - load (m_reader->m_index));
+  }
+
+  //----------------------------------------------------------------------------
+  //
+  // Producer
+  //
+
+  /** Add an element.
+
+      @return `false` if the ring was full.
+  */
+  bool push_back (Element const& element) noexcept
+  {
+    Element* dest;
+
+    bool const success = acquireWrite (&dest, 1) == 1;
+
+    if (success)
+    {
+      memcpy (dest, &element, sizeof (Element));
+      commitWrite (1);
+    }
+
+    return success;
+  }
+
+  /** Add a number of elements.
+
+      As many elements as fit are added, wrapping around the end of the
+      storage as needed.
+
+      @return The number of elements added.
+  */
+  int write (Element const* elements, int count) noexcept
+  {
+    int total = 0;
+
+    // At most two spans, before and after the wrap.
+    for (int i = 0; i < 2 && total < count; ++i)
+    {
+      Element* dest;
+      int const amount = acquireWrite (&dest, count - total);
+
+      if (amount == 0)
+        break;
+
+      memcpy (dest, elements + total, amount * sizeof (Element));
+      commitWrite (amount);
+
+      total += amount;
+    }
+
+    return total;
+  }
+
+  /** Get space to write elements in place.
+
+      This provides the largest contiguous span of free elements, up to
+      `maximumCount`. The span may be shorter than the free space when the
+      free space wraps around the end of the storage. The elements become
+      visible to the consumer after commitWrite().
+
+      @param[out] elements  A pointer to the first free element.
+
+      @param maximumCount   The largest number of elements wanted.
+
+      @return               The number of elements in the span, which may be 0.
+  */
+  int acquireWrite (Element** elements, int maximumCount) noexcept
+  {
+    Side& writer = *m_writer;
+    uint32 const index = writer.m_position;
+    uint32 const capacity = m_mask + 1;
+
+    uint32 available = capacity - (index - writer.m_cachedIndex);
+
+    if (available < uint32 (maximumCount))
+    {
+      writer.m_cachedIndex = load (m_reader->m_index);
+      available = capacity - (index - writer.m_cachedIndex);
+    }
+
+    uint32 const offset = index & m_mask;
+    uint32 const contiguous = jmin (available, capacity - offset);
+
+    *elements = m_elements + offset;
+
+    return int (jmin (contiguous, uint32 (maximumCount)));
+  }
+
+  /** Publish elements written in place.
+
+      @param count The number of elements to publish. This may not exceed the
+                   value returned by the last call to acquireWrite().
+  */
+  void commitWrite (int count) noexcept
+  {
+    Side& writer = *m_writer;
+
+    writer.m_position += uint32 (count);
+    writer.m_index.set (writer.m_position);
+  }
+
+  //----------------------------------------------------------------------------
+  //
+  // Consumer
+  //
+
+  /** Remove an element.
+
+      @return `false` if the ring was empty.
+  */
+  bool pop_front (Element* element) noexcept
+  {
+    Element const* source;
+
+    bool const success = acquireRead (&source, 1) == 1;
+
+    if (success)
+    {
+      memcpy (element, source, sizeof (Element));
+      commitRead (1);
+    }
+
+    return success;
+  }
+
+  /** Remove a number of elements.
+
+      @return The number of elements removed.
+  */
+  int read (Element* elements, int count) noexcept
+  {
+    int total = 0;
+
+    for (int i = 0; i < 2 && total < count; ++i)
+    {
+      Element const* source;
+      int const amount = acquireRead (&source, count - total);
+
+      if (amount == 0)
+        break;
+
+      memcpy (elements + total, source, amount * sizeof (Element));
+      commitRead (amount);
+
+      total += amount;
+    }
+
+    return total;
+  }
+
+  /** Get elements to read in place.
+
+      This provides the largest contiguous span of available elements, up to
+      `maximumCount`. The elements stay in the ring until commitRead().
+
+      @param[out] elements  A pointer to the first available element.
+
+      @param maximumCount   The largest number of elements wanted.
+
+      @return               The number of elements in the span, which may be 0.
+  */
+  int acquireRead (Element const** elements, int maximumCount) noexcept
+  {
+    Side& reader = *m_reader;
+    uint32 const index = reader.m_position;
+
+    uint32 available = reader.m_cachedIndex - index;
+
+    if (available < uint32 (maximumCount))
+    {
+      reader.m_cachedIndex = load (m_writer->m_index);
+      available = reader.m_cachedIndex - index;
+    }
+
+    uint32 const offset = index & m_mask;
+    uint32 const contiguous = jmin (available, m_mask + 1 - offset);
+
+    *elements = m_elements + offset;
+
+    return int (jmin (contiguous, uint32 (maximumCount)));
+  }
+
+  /** Release elements read in place.
+
+      @param count The number of elements to release. This may not exceed the
+                   value returned by the last call to acquireRead().
+  */
+  void commitRead (int count) noexcept
+  {
+    Side& reader = *m_reader;
+
+    reader.m_position += uint32 (count);
+    reader.m_index.set (reader.m_position);
+  }
+
+private:
+  struct Side
+  {
+    Atomic <uint32> m_index;      // published by the owner
+    uint32 m_position;            // owner's private copy of m_index
+    uint32 m_cachedIndex;         // owner's copy of the other side's index
+  };
+
+  // Reads the other side's index with a plain load. Atomic::get() may be
+  // implemented as an interlocked add, which would write to the line.
+  //
+  static uint32 load (Atomic <uint32> const& index) noexcept
+  {
+    Atomic <uint32>::memoryBarrier ();
+    uint32 const value = index.value;
+    Atomic <uint32>::memoryBarrier ();
+    return value;
+  }
+
+  CacheLine::Aligned <Side> m_writer;
+  CacheLine::Aligned <Side> m_reader;
+  uint32 m_mask;
+  HeapBlock <Element> m_elements;
+};
+
+#endif
@@ -34,6 +34,7 @@
 #define VF_LOCKFREESTACK_VFHEADER
 
 #include "../memory/vf_AtomicPointer.h"
+#include "../memory/vf_EpochReclaimer.h"
 
 struct LockFreeStackDefaultTag;
 
@@ -47,6 +48,11 @@ struct LockFreeStackDefaultTag;
   The caller is responsible for preventing the "ABA" problem
   (http://en.wikipedia.org/wiki/ABA_problem)
 
+  Nodes may be recycled safely by popping them inside an EpochReclaimer::Guard
+  and retiring them through the EpochReclaimer before they are pushed again
+  or freed. A popped node then cannot reappear at the head of the stack while
+  another thread is still in the middle of popping it.
+
   @param Tag  A type name used to distinguish lists and nodes, for
   putting objects in multiple lists. If this parameter is
   omitted, the default tag is used.
@@ -74,6 +80,66 @@ public:
     AtomicPointer <Node> m_next;
   };
 
+  /** A chain of elements removed from a stack.
+
+      The chain belongs to the thread which removed it, so taking elements
+      from it needs no synchronization.
+
+      @see pop_all
+  */
+  class Chain
+  {
+  public:
+    Chain () : m_head (nullptr)
+    {
+    }
+
+    /** Determine if the chain is empty. */
+    bool empty () const
+    {
+      return m_head == nullptr;
+    }
+
+    /** Take the first element off the chain.
+
+        @return The element, or nullptr if the chain was empty.
+    */
+    Element* pop_front ()
+    {
+      Node* const node = m_head;
+
+      if (node != nullptr)
+        m_head = getNext (node);
+
+      return static_cast <Element*> (node);
+    }
+
+    /** Reverse the order of the chain.
+
+        A chain comes off the stack newest first. Reversing it puts the
+        oldest element first.
+    */
+    void reverse ()
+    {
+      Node* reversed = nullptr;
+
+      while (m_head != nullptr)
+      {
+        Node* const next = getNext (m_head);
+        setNext (m_head, reversed);
+        reversed = m_head;
+        m_head = next;
+      }
+
+      m_head = reversed;
+    }
+
+  private:
+    friend class LockFreeStack;
+
+    Node* m_head;
+  };
+
 public:
   LockFreeStack () : m_head (0)
   {
@@ -99,6 +165,18 @@ public:
     m_head = head;
   }
 
+  /** Determine if the stack is empty.
+
+      The result may be out of date as soon as this returns, unless the
+      caller synchronizes.
+
+      @return true if the stack is empty.
+  */
+  bool empty () const
+  {
+    return m_head.get () == nullptr;
+  }
+
   /** Push a node onto the stack.
 
       The caller is responsible for preventing the ABA problem. This operation
@@ -149,6 +227,36 @@ public:
     return node ? static_cast <Element*> (node) : nullptr;
   }
 
+  /** Pop an element off the stack inside an epoch guard.
+
+      This is the same as pop_front(), and documents that the caller holds an
+      EpochReclaimer::Guard. If every popped node is retired through the
+      EpochReclaimer before it is pushed again or freed, the ABA problem
+      cannot occur.
+
+      @return   The element that was popped, or nullptr if the stack was empty.
+  */
+  Element* pop_front (EpochReclaimer::Guard const&)
+  {
+    return pop_front ();
+  }
+
+  /** Remove every element from the stack.
+
+      All elements are removed with a single atomic operation. Unlike
+      pop_front(), this is not subject to the ABA problem.
+
+      @return   The removed elements, newest first.
+  */
+  Chain pop_all ()
+  {
+    Chain chain;
+
+    chain.m_head = m_head.exchange (nullptr);
+
+    return chain;
+  }
+
   /** Swap the contents of this stack with another stack.
 
       This call is not thread safe or atomic. The caller is responsible for
@@ -163,6 +271,17 @@ public:
     m_head.set (temp);
   }
 
+private:
+  static Node* getNext (Node* node)
+  {
+    return node->m_next.get ();
+  }
+
+  static void setNext (Node* node, Node* next)
+  {
+    node->m_next.set (next);
+  }
+
 private:
   AtomicPointer <Node> m_head;
 };
@@ -0,0 +1,342 @@
+/*============================================================================*/
+/*
+  VFLib: https://github.com/vinniefalco/VFLib
+
+  Copyright (C) 2008 by Vinnie Falco <vinnie.falco@gmail.com>
+
+  This library contains portions of other open source products covered by
+  separate licenses. Please see the corresponding source files for specific
+  terms.
+  
+  VFLib is provided under the terms of The MIT License (MIT):
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+  IN THE SOFTWARE.
+*/
+/*============================================================================*/
+
+#ifndef VF_TAGGEDLOCKFREESTACK_VFHEADER
+#define VF_TAGGEDLOCKFREESTACK_VFHEADER
+
+struct LockFreeStackDefaultTag;
+
+/*============================================================================*/
+/** 
+  Multiple Producer, Multiple Consumer (MPMC) intrusive stack, ABA-safe.
+
+  This is a LockFreeStack whose head carries a generation counter next to
+  the pointer. The counter changes on every pop, so a pop which read a node
+  that was popped and pushed back in the meantime fails its compare-and-swap
+  and retries, instead of corrupting the stack. This makes it suitable for
+  free lists, where nodes are recycled all the time.
+
+  The head is stored as follows:
+
+  - On 64-bit x86 with a compiler that provides a 16 byte compare-and-swap
+    (cmpxchg16b), as a full pointer plus a 64-bit counter.
+
+  - On other 64-bit targets, as a 48-bit pointer with a 16-bit counter in the
+    upper bits. If a node's address does not fit in 48 bits, for example
+    because of a pointer tag, the stack falls back to a SpinLock from then
+    on and is no longer lock-free.
+
+  - On 32-bit targets, as a pointer plus a 32-bit counter in 64 bits.
+
+  Nodes must stay valid memory while any thread may still pop them, which
+  is the case for free lists that never give their memory back while in use.
+
+  @param Tag  A type name used to distinguish lists and nodes, for
+  putting objects in multiple lists. If this parameter is
+  omitted, the default tag is used.
+
+  @see LockFreeStack
+
+  @ingroup vf_core intrusive
+*/
+template <class Element, class Tag = LockFreeStackDefaultTag>
+class TaggedLockFreeStack : Uncopyable
+{
+public:
+  class Node : Uncopyable
+  {
+  public:
+    Node ()
+    {
+    }
+
+  private:
+    friend class TaggedLockFreeStack;
+
+    AtomicPointer <Node> m_next;
+  };
+
+public:
+  TaggedLockFreeStack ()
+  {
+  }
+
+  /** Push a node onto the stack.
+
+      This operation is lock-free.
+
+      @param node The node to push.
+
+      @return     True if the stack was previously empty. If multiple threads
+                  are attempting to push, only one will receive true.
+  */
+  bool push_front (Node* node)
+  {
+    Head head;
+    Head newHead;
+
+    do
+    {
+      head = m_head.load ();
+      node->m_next = head.node;
+      newHead.node = node;
+      newHead.count = head.count;
+    }
+    while (!m_head.compareAndSet (newHead, head));
+
+    return head.node == nullptr;
+  }
+
+  /** Pop an element off the stack.
+
+      This operation is lock-free.
+
+      @return   The element that was popped, or nullptr if the stack was empty.
+  */
+  Element* pop_front ()
+  {
+    Head head;
+    Head newHead;
+
+    do
+    {
+      head = m_head.load ();
+      if (head.node == nullptr)
+        break;
+      newHead.node = head.node->m_next.get ();
+      newHead.count = head.count + 1;
+    }
+    while (!m_head.compareAndSet (newHead, head));
+
+    return head.node ? static_cast <Element*> (head.node) : nullptr;
+  }
+
+  /** Swap the contents of this stack with another stack.
+
+      This call is not thread safe or atomic. The caller is responsible for
+      synchronizing access.
+
+      @param other  The other stack to swap contents with.
+  */
+  void swap (TaggedLockFreeStack& other)
+  {
+    Head const temp = other.m_head.load ();
+    other.m_head.store (m_head.load ());
+    m_head.store (temp);
+  }
+
+private:
+  struct Head
+  {
+    Head () : node (nullptr), count (0) { }
+
+    Node* node;
+    uint64 count;
+  };
+
+#if JUCE_64BIT && (defined (__GCC_HAVE_SYNC_COMPARE_AND_SWAP_16) || (JUCE_MSVC && JUCE_INTEL))
+  // Pointer and counter side by side, swapped with cmpxchg16b.
+  class AtomicHead
+  {
+  public:
+    AtomicHead ()
+    {
+      m_value [0] = 0;
+      m_value [1] = 0;
+    }
+
+    // The halves may be read at different times.
+    // That is harmless, the compare-and-swap catches it.
+    Head load () const noexcept
+    {
+      Head head;
+      head.node = reinterpret_cast <Node*> (m_value [0]);
+      head.count = uint64 (m_value [1]);
+      return head;
+    }
+
+    void store (Head const& head) noexcept
+    {
+      m_value [0] = reinterpret_cast <int64> (head.node);
+      m_value [1] = int64 (head.count);
+    }
+
+    bool compareAndSet (Head const& newValue, Head const& oldValue) noexcept
+    {
+    #if JUCE_MSVC
+      __int64 comparand [2] = { reinterpret_cast <__int64> (oldValue.node),
+                                __int64 (oldValue.count) };
+
+      return _InterlockedCompareExchange128 (m_value,
+        __int64 (newValue.count), reinterpret_cast <__int64> (newValue.node),
+        comparand) != 0;
+    #else
+      typedef unsigned __int128 Word;
+
+      Word const oldWord = (Word (oldValue.count) << 64) |
+        Word (reinterpret_cast <uint64> (oldValue.node));
+      Word const newWord = (Word (newValue.count) << 64) |
+        Word (reinterpret_cast <uint64> (newValue.node));
+
+      return __sync_bool_compare_and_swap (
+        reinterpret_cast <Word volatile*> (m_value), oldWord, newWord);
+    #endif
+    }
+
+  private:
+  #if JUCE_MSVC
+    __declspec (align (16)) int64 volatile m_value [2];
+  #else
+    int64 volatile m_value [2] __attribute__ ((aligned (16)));
+  #endif
+  };
+
+#else
+  // Pointer and counter packed into one 64-bit word.
+  //
+  // A pointer which does not fit, such as one carrying a tag in its top
+  // byte or one from a 57-bit address space, switches the head for good to
+  // a copy guarded by a SpinLock. The switch replaces the packed word with
+  // a marker that no aligned node can produce, so an operation that read
+  // the packed head before the switch fails its compare-and-swap, reads the
+  // marker, and continues on the locked copy.
+  //
+  class AtomicHead
+  {
+  public:
+    AtomicHead ()
+    {
+    }
+
+    Head load () const noexcept
+    {
+      uint64 const value = uint64 (m_value.get ());
+
+      if (value != lockedMarker)
+        return unpack (value);
+
+      SpinLock::ScopedLockType lock (m_mutex);
+
+      return m_locked;
+    }
+
+    void store (Head const& head) noexcept
+    {
+      if (m_value.get () != int64 (lockedMarker) && fits (head))
+      {
+        m_value.set (int64 (pack (head)));
+      }
+      else
+      {
+        SpinLock::ScopedLockType lock (m_mutex);
+
+        m_locked = head;
+        m_value.set (int64 (lockedMarker));
+      }
+    }
+
+    bool compareAndSet (Head const& newValue, Head const& oldValue) noexcept
+    {
+      if (fits (newValue) && fits (oldValue))
+      {
+        if (m_value.compareAndSetBool (int64 (pack (newValue)), int64 (pack (oldValue))))
+          return true;
+
+        if (m_value.get () != int64 (lockedMarker))
+          return false;
+      }
+
+      SpinLock::ScopedLockType lock (m_mutex);
+
+      if (m_value.get () != int64 (lockedMarker))
+      {
+        // Switch to the locked copy, as part of this operation.
+        if (! fits (oldValue) ||
+            ! m_value.compareAndSetBool (int64 (lockedMarker), int64 (pack (oldValue))))
+          return false;
+
+        m_locked = newValue;
+
+        return true;
+      }
+
+      if (m_locked.node != oldValue.node || m_locked.count != oldValue.count)
+        return false;
+
+      m_locked = newValue;
+
+      return true;
+    }
+
+  private:
+    enum
+    {
+      pointerBits = (sizeof (void*) == 8) ? 48 : 32
+    };
+
+    // Nodes are at least pointer aligned, so no packed head is odd.
+    static uint64 const lockedMarker = 1;
+
+    static bool fits (Head const& head) noexcept
+    {
+      uint64 const pointer = uint64 (reinterpret_cast <pointer_sized_int> (head.node));
+
+      return (pointer >> pointerBits) == 0;
+    }
+
+    static uint64 pack (Head const& head) noexcept
+    {
+      uint64 const pointer = uint64 (reinterpret_cast <pointer_sized_int> (head.node));
+
+      return (head.count << pointerBits) | pointer;
+    }
+
+    static Head unpack (uint64 value) noexcept
+    {
+      Head head;
+      head.node = reinterpret_cast <Node*> (pointer_sized_int (
+        value & ((uint64 (1) << pointerBits) - 1)));
+      head.count = value >> pointerBits;
+      return head;
+    }
+
+    Atomic <int64> m_value;
+    SpinLock mutable m_mutex;
+    Head m_locked;
+  };
+
+#endif
+
+  AtomicHead m_head;
+};
+
+#endif
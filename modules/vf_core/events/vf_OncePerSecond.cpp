@@ -30,82 +30,9 @@
 */
 /*============================================================================*/
 
-class OncePerSecond::TimerSingleton
-  : public RefCountedSingleton <OncePerSecond::TimerSingleton>
-{
-private:
-  TimerSingleton ()
-    : RefCountedSingleton <OncePerSecond::TimerSingleton> (
-		SingletonLifetime::persistAfterCreation)
-    , m_thread ("Once Per Second")
-  {
-    m_thread.start (vf::bind (&TimerSingleton::run, this));
-  }
-
-  ~TimerSingleton ()
-  {
-    m_thread.join ();
-
-    jassert (m_list.empty ());
-  }
-
-  void run ()
-  {
-    for(;;)
-    {
-      const bool interrupted = m_thread.wait (1000);
-
-      if (interrupted)
-        break;
-
-      notify();
-    }
-  }
-
-  void notify ()
-  {
-    CriticalSection::ScopedLockType lock (m_mutex);
-
-    for (List <Elem>::iterator iter = m_list.begin(); iter != m_list.end();)
-    {
-      OncePerSecond* object = iter->object;
-      ++iter;
-      object->doOncePerSecond ();
-    }
-  }
-
-public:
-  void insert (Elem* elem)
-  {
-    CriticalSection::ScopedLockType lock (m_mutex);
-
-    m_list.push_back (*elem);
-  }
-
-  void remove (Elem* elem)
-  {
-    CriticalSection::ScopedLockType lock (m_mutex);
-
-    m_list.erase (m_list.iterator_to (*elem));
-  }
-
-  static TimerSingleton* createInstance ()
-  {
-    return new TimerSingleton;
-  }
-
-private:
-  InterruptibleThread m_thread;
-  CriticalSection m_mutex;
-  List <Elem> m_list;
-};
-
-//------------------------------------------------------------------------------
-
 OncePerSecond::OncePerSecond ()
+  : m_timer (this)
 {
-  m_elem.instance = TimerSingleton::getInstance ();
-  m_elem.object = this;
 }
 
 OncePerSecond::~OncePerSecond ()
@@ -114,10 +41,10 @@ OncePerSecond::~OncePerSecond ()
 
 void OncePerSecond::startOncePerSecond ()
 {
-  m_elem.instance->insert (&m_elem);
+  m_timer.startTimer (1000, 1000);
 }
 
 void OncePerSecond::endOncePerSecond ()
 {
-  m_elem.instance->remove (&m_elem);
+  m_timer.stopTimer ();
 }
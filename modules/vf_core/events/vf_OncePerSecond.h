@@ -33,7 +33,7 @@
 #ifndef VF_ONCEPERSECOND_VFHEADER
 #define VF_ONCEPERSECOND_VFHEADER
 
-#include "../containers/vf_List.h"
+#include "vf_TimerWheel.h"
 
 /*============================================================================*/
 /** 
@@ -43,6 +43,8 @@
     call startOncePerSecond() to begin receiving the notifications. No clean-up
     or other actions are required.
 
+    The notifications come from the TimerWheel thread.
+
     @ingroup vf_core
 */
 class OncePerSecond : Uncopyable
@@ -62,16 +64,18 @@ protected:
   virtual void doOncePerSecond () = 0;
 
 private:
-  class TimerSingleton;
-  typedef ReferenceCountedObjectPtr <TimerSingleton> TimerPtr;
-
-  struct Elem : List <Elem>::Node
+  class Timer : public TimerWheel::Timer
   {
-    TimerPtr instance;
-    OncePerSecond* object;
+  public:
+    explicit Timer (OncePerSecond* owner) : m_owner (owner) { }
+
+  private:
+    void onTimer () { m_owner->doOncePerSecond (); }
+
+    OncePerSecond* const m_owner;
   };
 
-  Elem m_elem;
+  Timer m_timer;
 };
 
 #endif
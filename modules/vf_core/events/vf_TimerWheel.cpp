@@ -0,0 +1,368 @@
+/*============================================================================*/
+/*
+  VFLib: https://github.com/vinniefalco/VFLib
+
+  Copyright (C) 2008 by Vinnie Falco <vinnie.falco@gmail.com>
+
+  This library contains portions of other open source products covered by
+  separate licenses. Please see the corresponding source files for specific
+  terms.
+  
+  VFLib is provided under the terms of The MIT License (MIT):
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+  IN THE SOFTWARE.
+*/
+/*============================================================================*/
+
+class TimerWheel::Wheel : public RefCountedSingleton <TimerWheel::Wheel>
+{
+public:
+  void insert (Timer& timer, int delayMilliseconds, int periodMilliseconds)
+  {
+    CriticalSection::ScopedLockType lock (m_mutex);
+
+    unlink (timer);
+
+    timer.m_period = periodMilliseconds;
+
+    if (m_numberOfTimers == 0)
+    {
+      // Nothing needs processing, so skip ahead to the present.
+      m_currentTick = jmax (m_currentTick, getCurrentTick ());
+    }
+
+    // The slot for the current tick has already been processed.
+    int64 const expiry = jmax (m_currentTick + 1,
+                               getCurrentTick () + jmax (0, delayMilliseconds));
+
+    schedule (timer, expiry);
+
+    // Wake the thread if this timer is due before it would wake up.
+    if (m_wakeTick == -1 || timer.m_expiry < m_wakeTick)
+      m_thread.interrupt ();
+  }
+
+  bool remove (Timer& timer)
+  {
+    CriticalSection::ScopedLockType lock (m_mutex);
+
+    timer.m_period = 0;
+
+    return unlink (timer);
+  }
+
+  static Wheel* createInstance ()
+  {
+    return new Wheel;
+  }
+
+private:
+  enum
+  {
+    bitsPerLevel = 6,
+    slotsPerLevel = 1 << bitsPerLevel,
+    slotMask = slotsPerLevel - 1,
+    numberOfLevels = 6
+  };
+
+  typedef List <Timer> Slot;
+
+  Wheel ()
+    : RefCountedSingleton <TimerWheel::Wheel> (
+        SingletonLifetime::persistAfterCreation)
+    , m_thread ("Timer Wheel")
+    , m_currentTick (getCurrentTick ())
+    , m_wakeTick (-1)
+    , m_numberOfTimers (0)
+  {
+    m_thread.start (vf::bind (&Wheel::run, this));
+  }
+
+  ~Wheel ()
+  {
+    m_shouldExit.signal ();
+    m_thread.interrupt ();
+    m_thread.join ();
+
+    jassert (m_numberOfTimers == 0);
+  }
+
+  static int64 getCurrentTick ()
+  {
+    return int64 (Time::getMillisecondCounterHiRes ());
+  }
+
+  // Put a timer in the slot for its expiration time, relative to the
+  // current tick. The level is the highest group of bits in which the
+  // expiration differs from the current tick. A timer which expires on the
+  // current tick goes in its level 0 slot, which is only processed after
+  // cascading, so callers must otherwise pass a tick in the future.
+  //
+  void schedule (Timer& timer, int64 expiry)
+  {
+    jassert (expiry >= m_currentTick);
+
+    int64 const difference = expiry ^ m_currentTick;
+
+    int level = 0;
+
+    while (level < numberOfLevels &&
+           (difference >> (bitsPerLevel * (level + 1))) != 0)
+      ++level;
+
+    Slot& slot = (level < numberOfLevels) ?
+      m_slots [level][(expiry >> (bitsPerLevel * level)) & slotMask] :
+      m_overflow;
+
+    timer.m_expiry = expiry;
+    timer.m_list = &slot;
+    slot.push_back (timer);
+
+    ++m_numberOfTimers;
+  }
+
+  bool unlink (Timer& timer)
+  {
+    bool const wasScheduled = timer.m_list != nullptr;
+
+    if (wasScheduled)
+    {
+      timer.m_list->erase (timer.m_list->iterator_to (timer));
+      timer.m_list = nullptr;
+
+      --m_numberOfTimers;
+    }
+
+    return wasScheduled;
+  }
+
+  // Returns the next tick at which a slot must be processed, or -1 if
+  // there are no timers.
+  //
+  int64 getNextEventTick () const
+  {
+    int64 next = -1;
+
+    for (int level = 0; level < numberOfLevels; ++level)
+    {
+      int const shift = bitsPerLevel * level;
+      int64 const base = (m_currentTick >> (shift + bitsPerLevel)) << (shift + bitsPerLevel);
+
+      for (int index = int ((m_currentTick >> shift) & slotMask) + 1; index < slotsPerLevel; ++index)
+      {
+        if (! m_slots [level][index].empty ())
+        {
+          int64 const tick = base | (int64 (index) << shift);
+
+          if (next == -1 || tick < next)
+            next = tick;
+
+          break;
+        }
+      }
+    }
+
+    if (! m_overflow.empty ())
+    {
+      int const shift = bitsPerLevel * numberOfLevels;
+      int64 const tick = ((m_currentTick >> shift) + 1) << shift;
+
+      if (next == -1 || tick < next)
+        next = tick;
+    }
+
+    return next;
+  }
+
+  // Move the timers in a slot to the lower levels.
+  //
+  void cascade (Slot& slot)
+  {
+    while (! slot.empty ())
+    {
+      Timer& timer (slot.front ());
+
+      slot.pop_front ();
+      timer.m_list = nullptr;
+      --m_numberOfTimers;
+
+      schedule (timer, timer.m_expiry);
+    }
+  }
+
+  void processTick (int64 tick)
+  {
+    // Cascade from the highest level whose slot boundary is reached.
+    for (int level = numberOfLevels; level > 0; --level)
+    {
+      int const shift = bitsPerLevel * level;
+
+      if ((tick & ((int64 (1) << shift) - 1)) == 0)
+      {
+        if (level == numberOfLevels)
+          cascade (m_overflow);
+        else
+          cascade (m_slots [level][(tick >> shift) & slotMask]);
+      }
+    }
+
+    Slot& slot = m_slots [0][tick & slotMask];
+
+    if (! slot.empty ())
+    {
+      // Take the due timers out of the wheel first, because the
+      // callbacks can start and stop timers, including these.
+      //
+      Slot due;
+      due.append (slot);
+
+      for (Slot::iterator iter = due.begin (); iter != due.end (); ++iter)
+        iter->m_list = &due;
+
+      while (! due.empty ())
+      {
+        Timer& timer (due.front ());
+
+        due.pop_front ();
+        timer.m_list = nullptr;
+        --m_numberOfTimers;
+
+        if (timer.m_period == 0)
+        {
+          // The timer may delete itself, so don't touch it afterwards.
+          timer.onTimer ();
+        }
+        else
+        {
+          int64 const expiry = timer.m_expiry;
+
+          timer.onTimer ();
+
+          // Reschedule, unless the callback stopped or restarted it.
+          if (timer.m_period != 0 && timer.m_list == nullptr)
+          {
+            int64 next = expiry + timer.m_period;
+
+            if (next <= m_currentTick)
+              next = m_currentTick + timer.m_period;
+
+            schedule (timer, next);
+          }
+        }
+      }
+    }
+  }
+
+  // Process every slot that is due, up to the present.
+  //
+  void advance (int64 now)
+  {
+    for (;;)
+    {
+      int64 const next = getNextEventTick ();
+
+      if (next == -1 || next > now)
+      {
+        // Nothing happens in between, so we can jump ahead.
+        if (m_currentTick < now)
+          m_currentTick = now;
+
+        break;
+      }
+
+      m_currentTick = next;
+
+      processTick (next);
+    }
+  }
+
+  void run ()
+  {
+    for (;;)
+    {
+      int milliSeconds;
+
+      {
+        CriticalSection::ScopedLockType lock (m_mutex);
+
+        advance (getCurrentTick ());
+
+        m_wakeTick = getNextEventTick ();
+
+        if (m_wakeTick == -1)
+          milliSeconds = -1;
+        else
+          milliSeconds = int (jlimit (int64 (0), int64 (0x7fffffff),
+                                      m_wakeTick - getCurrentTick ()));
+      }
+
+      m_thread.wait (milliSeconds);
+
+      if (m_shouldExit.isSignaled ())
+        break;
+    }
+  }
+
+private:
+  friend class RefCountedSingleton <TimerWheel::Wheel>;
+
+  InterruptibleThread m_thread;
+  AtomicFlag m_shouldExit;
+  CriticalSection m_mutex;
+  int64 m_currentTick;
+  int64 m_wakeTick;
+  int m_numberOfTimers;
+  Slot m_slots [numberOfLevels][slotsPerLevel];
+  Slot m_overflow;
+};
+
+//------------------------------------------------------------------------------
+
+TimerWheel::Timer::Timer ()
+  : m_wheel (Wheel::getInstance ())
+  , m_list (nullptr)
+  , m_expiry (0)
+  , m_period (0)
+{
+}
+
+TimerWheel::Timer::~Timer ()
+{
+  // If this goes off it means the derived class forgot to stop the timer.
+  jassert (m_list == nullptr);
+
+  stopTimer ();
+}
+
+void TimerWheel::Timer::startTimer (int delayMilliseconds, int periodMilliseconds)
+{
+  jassert (periodMilliseconds >= 0);
+
+  m_wheel->insert (*this, delayMilliseconds, periodMilliseconds);
+}
+
+bool TimerWheel::Timer::stopTimer ()
+{
+  return m_wheel->remove (*this);
+}
+
+bool TimerWheel::Timer::isTimerRunning () const
+{
+  return m_list != nullptr;
+}
@@ -0,0 +1,147 @@
+/*============================================================================*/
+/*
+  VFLib: https://github.com/vinniefalco/VFLib
+
+  Copyright (C) 2008 by Vinnie Falco <vinnie.falco@gmail.com>
+
+  This library contains portions of other open source products covered by
+  separate licenses. Please see the corresponding source files for specific
+  terms.
+  
+  VFLib is provided under the terms of The MIT License (MIT):
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+  IN THE SOFTWARE.
+*/
+/*============================================================================*/
+
+#ifndef VF_TIMERWHEEL_VFHEADER
+#define VF_TIMERWHEEL_VFHEADER
+
+#include "../containers/vf_List.h"
+
+/*============================================================================*/
+/**
+  A hierarchical timer wheel.
+
+  All timers share a single thread. Timers are kept in six levels of 64
+  slots each, where a slot in level 0 covers one millisecond and a slot in
+  each higher level covers 64 times the span of a slot in the level below.
+  Starting and stopping a timer takes constant time regardless of how many
+  timers there are. When time reaches a slot in a higher level, its timers
+  are redistributed into the lower levels, and the thread only wakes up when
+  a slot is due, so an idle wheel costs nothing.
+
+  Derive from TimerWheel::Timer and override onTimer():
+
+  @code
+
+  class Blinker : private TimerWheel::Timer
+  {
+  public:
+    Blinker ()
+    {
+      startTimer (500, 500);
+    }
+
+    ~Blinker ()
+    {
+      stopTimer ();
+    }
+
+  private:
+    void onTimer ()
+    {
+      // called on the timer thread every 500 milliseconds
+    }
+  };
+
+  @endcode
+
+  @see OncePerSecond
+
+  @ingroup vf_core
+*/
+class TimerWheel : Uncopyable
+{
+private:
+  class Wheel;
+  typedef ReferenceCountedObjectPtr <Wheel> WheelPtr;
+
+public:
+  /** A timer on the wheel.
+  */
+  class Timer : public List <Timer>::Node
+  {
+  public:
+    Timer ();
+
+    /** Destroy the timer.
+
+        A derived class must stop the timer in its own destructor, since
+        onTimer() could otherwise be called while it is being destroyed.
+    */
+    virtual ~Timer ();
+
+    /** Start or restart the timer.
+
+        If the timer is already running, it is rescheduled.
+
+        @param delayMilliseconds  The time until the first call to onTimer().
+
+        @param periodMilliseconds The time between later calls to onTimer(),
+                                  or 0 for a timer which only fires once.
+    */
+    void startTimer (int delayMilliseconds, int periodMilliseconds = 0);
+
+    /** Stop the timer.
+
+        When this returns, onTimer() is not running on the timer thread and
+        will not be called again, unless this is called from onTimer().
+
+        @return `true` if the timer was scheduled when it was stopped.
+    */
+    bool stopTimer ();
+
+    /** Determine if the timer is scheduled.
+
+        This returns `false` while onTimer() is running.
+    */
+    bool isTimerRunning () const;
+
+  protected:
+    /** Called on the timer thread when the timer fires.
+
+        Timers are serialized, so this should return quickly. It may start
+        or stop any timer, including this one. A timer which only fires once
+        may delete itself here, since the wheel does not touch it after
+        this returns.
+    */
+    virtual void onTimer () = 0;
+
+  private:
+    friend class TimerWheel;
+
+    WheelPtr m_wheel;
+    List <Timer>* m_list;
+    int64 m_expiry;
+    int m_period;
+  };
+};
+
+#endif
@@ -95,6 +95,18 @@ public:
   #endif
   }
 
+  /** Reset the flag if it is signaled.
+
+      If two or more threads simultaneously attempt to reset the flag,
+      only one will receive a true return value.
+
+      @return true if the flag was previously signaled.
+  */
+  inline bool tryReset () noexcept
+  {
+    return m_value.compareAndSetBool (0, 1);
+  }
+
   /** Check if the AtomicFlag is signaled
 
       The signaled status may change immediately after this call
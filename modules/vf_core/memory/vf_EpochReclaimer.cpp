@@ -0,0 +1,230 @@
+/*============================================================================*/
+/*
+  VFLib: https://github.com/vinniefalco/VFLib
+
+  Copyright (C) 2008 by Vinnie Falco <vinnie.falco@gmail.com>
+
+  This library contains portions of other open source products covered by
+  separate licenses. Please see the corresponding source files for specific
+  terms.
+  
+  VFLib is provided under the terms of The MIT License (MIT):
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+  IN THE SOFTWARE.
+*/
+/*============================================================================*/
+
+// Every participating thread publishes the epoch it saw when it entered its
+// outermost guard. The reclaimer only advances the global epoch once every
+// thread inside a guard has seen the current one. An object retired during
+// epoch e was unreachable for anyone entering after that, so once the epoch
+// reaches e + 2, every thread which might have seen it has left its guard.
+// Retired objects are kept in three lists, one per epoch modulo three.
+
+class EpochReclaimer::Record
+{
+public:
+  Record () : m_next (nullptr), m_inUse (1)
+  {
+  }
+
+  Record* m_next;
+  Atomic <int> m_inUse;
+
+  // 0 when outside a guard, else (epoch << 1) | 1
+  CacheLine::Padded <Atomic <int> > m_state;
+};
+
+//------------------------------------------------------------------------------
+
+class EpochReclaimer::Reclaimer
+  : public RefCountedSingleton <EpochReclaimer::Reclaimer>
+  , private OncePerSecond
+{
+public:
+  enum
+  {
+    numberOfLists = 3,
+
+    // Wraps at a multiple of the number of lists
+    maximumEpoch = numberOfLists << 28
+  };
+
+  Record* acquireRecord ()
+  {
+    for (Record* record = m_records.get (); record != nullptr; record = record->m_next)
+    {
+      if (record->m_inUse.compareAndSetBool (1, 0))
+        return record;
+    }
+
+    Record* const record = new Record;
+    Record* head;
+
+    do
+    {
+      head = m_records.get ();
+      record->m_next = head;
+    }
+    while (!m_records.compareAndSet (record, head));
+
+    return record;
+  }
+
+  void releaseRecord (Record* record)
+  {
+    record->m_inUse.set (0);
+  }
+
+  int getEpoch () const
+  {
+    return m_epoch.get ();
+  }
+
+  void retire (Retired* object)
+  {
+    AtomicPointer <Retired>& list = m_retired [m_epoch.get () % numberOfLists];
+    Retired* head;
+
+    do
+    {
+      head = list.get ();
+      object->m_nextRetired = head;
+    }
+    while (!list.compareAndSet (object, head));
+  }
+
+  void reclaim ()
+  {
+    CriticalSection::ScopedTryLockType lock (m_mutex);
+
+    if (lock.isLocked ())
+    {
+      int const epoch = m_epoch.get ();
+      int const state = (epoch << 1) | 1;
+
+      for (Record* record = m_records.get (); record != nullptr; record = record->m_next)
+      {
+        int const recordState = record->m_state->get ();
+
+        if (recordState != 0 && recordState != state)
+          return;
+      }
+
+      int const nextEpoch = (epoch + 1) % maximumEpoch;
+
+      m_epoch.set (nextEpoch);
+
+      // This list holds what was retired during epoch - 1.
+      reclaim (m_retired [(nextEpoch + 1) % numberOfLists].exchange (nullptr));
+    }
+  }
+
+  static Reclaimer* createInstance ()
+  {
+    return new Reclaimer;
+  }
+
+private:
+  Reclaimer ()
+    : RefCountedSingleton <EpochReclaimer::Reclaimer> (
+        SingletonLifetime::persistAfterCreation)
+  {
+    startOncePerSecond ();
+  }
+
+  ~Reclaimer ()
+  {
+    endOncePerSecond ();
+
+    // No participants are left.
+    for (int i = 0; i < numberOfLists; ++i)
+      reclaim (m_retired [i].exchange (nullptr));
+
+    Record* record = m_records.get ();
+    while (record != nullptr)
+    {
+      Record* const next = record->m_next;
+      delete record;
+      record = next;
+    }
+  }
+
+  static void reclaim (Retired* object)
+  {
+    while (object != nullptr)
+    {
+      Retired* const next = object->m_nextRetired;
+      object->reclaim ();
+      object = next;
+    }
+  }
+
+  void doOncePerSecond ()
+  {
+    reclaim ();
+  }
+
+private:
+  friend class RefCountedSingleton <EpochReclaimer::Reclaimer>;
+
+  CriticalSection m_mutex;
+  Atomic <int> m_epoch;
+  AtomicPointer <Record> m_records;
+  AtomicPointer <Retired> m_retired [numberOfLists];
+};
+
+//------------------------------------------------------------------------------
+
+EpochReclaimer::Participant::Participant ()
+  : m_reclaimer (Reclaimer::getInstance ())
+  , m_record (m_reclaimer->acquireRecord ())
+  , m_depth (0)
+{
+}
+
+EpochReclaimer::Participant::~Participant ()
+{
+  // If this goes off it means a Guard outlived its Participant.
+  jassert (m_depth == 0);
+
+  m_reclaimer->releaseRecord (m_record);
+}
+
+void EpochReclaimer::Participant::retire (Retired* object)
+{
+  m_reclaimer->retire (object);
+}
+
+void EpochReclaimer::Participant::reclaim ()
+{
+  jassert (m_depth == 0);
+
+  m_reclaimer->reclaim ();
+}
+
+void EpochReclaimer::Participant::enter ()
+{
+  m_record->m_state->set ((m_reclaimer->getEpoch () << 1) | 1);
+}
+
+void EpochReclaimer::Participant::leave ()
+{
+  m_record->m_state->set (0);
+}
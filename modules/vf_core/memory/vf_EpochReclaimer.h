@@ -0,0 +1,185 @@
+/*============================================================================*/
+/*
+  VFLib: https://github.com/vinniefalco/VFLib
+
+  Copyright (C) 2008 by Vinnie Falco <vinnie.falco@gmail.com>
+
+  This library contains portions of other open source products covered by
+  separate licenses. Please see the corresponding source files for specific
+  terms.
+  
+  VFLib is provided under the terms of The MIT License (MIT):
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+  IN THE SOFTWARE.
+*/
+/*============================================================================*/
+
+#ifndef VF_EPOCHRECLAIMER_VFHEADER
+#define VF_EPOCHRECLAIMER_VFHEADER
+
+/*============================================================================*/
+/**
+  Epoch based memory reclamation.
+
+  Lock-free containers hand out pointers to nodes which another thread may
+  remove at any moment. If the node is freed, or recycled and pushed back,
+  while a thread still looks at it, the result is a crash or the ABA problem.
+  This facility defers reclaiming such nodes until no thread can still be
+  looking at them.
+
+  Threads that access shared nodes register by creating a Participant and
+  keeping it for as long as they use it. Each access is wrapped in a Guard.
+  Once a node is unlinked from the shared structure, the thread passes it to
+  Participant::retire() instead of deleting or reusing it directly. The node
+  is reclaimed later, once every thread which was inside a guard at the time
+  has left it. Retired nodes are reclaimed on the TimerWheel thread once per
+  second, or sooner with Participant::reclaim().
+
+  @code
+
+  struct Item : LockFreeStack <Item>::Node, EpochReclaimer::Retired
+  {
+    void reclaim () { freeItems.push_front (this); } // safe to reuse now
+  };
+
+  LockFreeStack <Item> freeItems;
+
+  void worker ()
+  {
+    EpochReclaimer::Participant participant;
+
+    for (;;)
+    {
+      Item* item;
+      {
+        EpochReclaimer::Guard guard (participant);
+        item = freeItems.pop_front (guard);
+      }
+
+      // ... use item ...
+
+      participant.retire (item);
+    }
+  }
+
+  @endcode
+
+  A thread which stays inside a guard holds up reclamation for everyone, so
+  guards should be short.
+
+  @ingroup vf_core
+*/
+class EpochReclaimer : Uncopyable
+{
+private:
+  class Reclaimer;
+  class Record;
+  typedef ReferenceCountedObjectPtr <Reclaimer> ReclaimerPtr;
+
+public:
+  class Guard;
+
+  /** An object which can be retired.
+  */
+  class Retired : Uncopyable
+  {
+  public:
+    Retired () { }
+
+    virtual ~Retired () { }
+
+    /** Called when no thread can still see the object.
+
+        This is called on the TimerWheel thread, or on the thread which
+        called Participant::reclaim(). The default implementation deletes
+        the object.
+    */
+    virtual void reclaim ()
+    {
+      delete this;
+    }
+
+  private:
+    friend class EpochReclaimer;
+
+    Retired* m_nextRetired;
+  };
+
+  /** A thread's registration with the reclaimer.
+
+      Each thread which uses guards needs its own Participant. A Participant
+      may not be shared between threads.
+  */
+  class Participant : Uncopyable
+  {
+  public:
+    Participant ();
+
+    ~Participant ();
+
+    /** Reclaim an object once it is safe.
+
+        The object must already be unreachable for threads that enter
+        a guard from now on.
+    */
+    void retire (Retired* object);
+
+    /** Try to reclaim retired objects now.
+
+        This must not be called inside a guard.
+    */
+    void reclaim ();
+
+  private:
+    friend class Guard;
+
+    void enter ();
+    void leave ();
+
+    ReclaimerPtr m_reclaimer;
+    Record* const m_record;
+    int m_depth;
+  };
+
+  /** A scope in which shared nodes may be accessed.
+
+      Guards may be nested.
+  */
+  class Guard : Uncopyable
+  {
+  public:
+    explicit Guard (Participant& participant)
+      : m_participant (participant)
+    {
+      if (m_participant.m_depth++ == 0)
+        m_participant.enter ();
+    }
+
+    ~Guard ()
+    {
+      if (--m_participant.m_depth == 0)
+        m_participant.leave ();
+    }
+
+  private:
+    Participant& m_participant;
+  };
+};
+
+#endif
@@ -30,6 +30,67 @@
 */
 /*============================================================================*/
 
+#if JUCE_LINUX
+
+// The count never goes below zero. A thread which finds no resource
+// announces itself in m_numberOfWaiters and sleeps on the count while it is
+// still zero. The kernel checks the value and queues the thread atomically,
+// so a signal which lands between our check and the sleep just makes the
+// futex call return at once.
+
+Semaphore::Semaphore (int initialCount)
+  : m_counter (initialCount)
+{
+  jassert (initialCount >= 0);
+}
+
+Semaphore::~Semaphore ()
+{
+  // Can't delete the semaphore while threads are waiting on it!!
+  jassert (m_numberOfWaiters.get () == 0);
+}
+
+// The kernel needs the address of the integer itself.
+int* Semaphore::getFutexWord ()
+{
+  return reinterpret_cast <int*> (&m_counter.value);
+}
+
+void Semaphore::signal (int amount)
+{
+  jassert (amount > 0);
+
+  m_counter += amount;
+
+  if (m_numberOfWaiters.get () > 0)
+    syscall (SYS_futex, getFutexWord (), FUTEX_WAKE_PRIVATE, amount, nullptr, nullptr, 0);
+}
+
+void Semaphore::wait ()
+{
+  for (;;)
+  {
+    int const count = m_counter.get ();
+
+    if (count > 0)
+    {
+      if (m_counter.compareAndSetBool (count - 1, count))
+        break;
+    }
+    else
+    {
+      ++m_numberOfWaiters;
+
+      // Spurious returns and EINTR just go around again.
+      syscall (SYS_futex, getFutexWord (), FUTEX_WAIT_PRIVATE, 0, nullptr, nullptr, 0);
+
+      --m_numberOfWaiters;
+    }
+  }
+}
+
+#else
+
 Semaphore::WaitingThread::WaitingThread ()
   : m_event (false) // auto-reset
 {
@@ -127,3 +188,5 @@ void Semaphore::wait ()
     m_deleteList.push_front (waitingThread);
   }
 }
+
+#endif
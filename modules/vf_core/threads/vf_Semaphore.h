@@ -42,6 +42,10 @@
 
   @note There is no tryWait() or timeout facility for acquiring a resource.
 
+  On Linux the semaphore is a single atomic count plus a futex. Signaling or
+  acquiring an available resource makes no system call unless a thread is
+  asleep, and no memory is allocated for waiting threads.
+
   @ingroup vf_core
 */
 class Semaphore
@@ -66,8 +70,15 @@ public:
   void wait ();
 
 private:
+#if JUCE_LINUX
+  int* getFutexWord ();
+
+  Atomic <int> m_counter;
+  Atomic <int> m_numberOfWaiters;
+
+#else
   class WaitingThread
-    : public LockFreeStack <WaitingThread>::Node
+    : public TaggedLockFreeStack <WaitingThread>::Node
     , LeakChecked <WaitingThread>
   {
   public:
@@ -84,8 +95,9 @@ private:
 
   LockType m_mutex;
   Atomic <int> m_counter;
-  LockFreeStack <WaitingThread> m_waitingThreads;
-  LockFreeStack <WaitingThread> m_deleteList;
+  TaggedLockFreeStack <WaitingThread> m_waitingThreads;
+  TaggedLockFreeStack <WaitingThread> m_deleteList;
+#endif
 };
 
 #endif
@@ -46,6 +46,12 @@
 #include <crtdbg.h>
 #endif
 
+#if JUCE_LINUX
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 #if JUCE_MSVC
 #pragma warning (push)
 #pragma warning (disable: 4100) // unreferenced formal parmaeter
@@ -63,9 +69,12 @@ namespace vf
 
 #include "events/vf_OncePerSecond.cpp"
 #include "events/vf_PerformedAtExit.cpp"
+#include "events/vf_TimerWheel.cpp"
 
 #include "math/vf_MurmurHash.cpp"
 
+#include "memory/vf_EpochReclaimer.cpp"
+
 #include "threads/vf_InterruptibleThread.cpp"
 #include "threads/vf_Semaphore.cpp"
 
@@ -277,6 +277,10 @@
 #define VF_USE_LEAKCHECKED JUCE_CHECK_MEMORY_LEAKS
 #endif
 
+#ifndef VF_USE_CALLQUEUE_STATISTICS
+#define VF_USE_CALLQUEUE_STATISTICS 0
+#endif
+
 /* Get this early so we can use it. */
 #include "modules/juce_core/system/juce_TargetPlatform.h"
 
@@ -298,6 +302,7 @@
 
 #if JUCE_MSVC
 # include <crtdbg.h>
+# include <intrin.h>
 # include <functional>
 
 #elif JUCE_IOS
@@ -448,15 +453,19 @@ using namespace juce;
 #include "diagnostic/vf_SafeBool.h"
 #include "diagnostic/vf_Throw.h"
 
+#include "containers/vf_BoundedLockFreeQueue.h"
 #include "containers/vf_List.h"
 #include "containers/vf_LockFreeStack.h"
 #include "containers/vf_LockFreeQueue.h"
+#include "containers/vf_LockFreeRingBuffer.h"
 #include "containers/vf_Map2D.h"
 #include "containers/vf_SharedTable.h"
 #include "containers/vf_SortedLookupTable.h"
+#include "containers/vf_TaggedLockFreeStack.h"
 
 #include "events/vf_OncePerSecond.h"
 #include "events/vf_PerformedAtExit.h"
+#include "events/vf_TimerWheel.h"
 
 #include "functor/vf_Bind.h"
 #include "functor/vf_Function.h"
@@ -481,6 +490,7 @@ using namespace juce;
 #pragma warning (pop)
 #endif
 
+#include "memory/vf_EpochReclaimer.h"
 #include "memory/vf_MemoryAlignment.h"
 #include "memory/vf_RefCountedSingleton.h"
 #include "memory/vf_StaticObject.h"